@@ -0,0 +1,62 @@
+/**
+ * File:	AlignedAllocator.h
+ *
+ * Summary:
+ *
+ * Minimal std::allocator replacement that hands out memory aligned to
+ * ALIGN bytes, so std::vector can back arrays that are read with aligned
+ * vector loads.
+ */
+
+#ifndef ALIGNED_ALLOCATOR_H
+#define ALIGNED_ALLOCATOR_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+template <typename T, std::size_t ALIGN> class AlignedAllocator {
+public:
+  typedef T value_type;
+
+  template <typename U> struct rebind {
+    typedef AlignedAllocator<U, ALIGN> other;
+  };
+
+public:
+  AlignedAllocator() {}
+  template <typename U>
+  AlignedAllocator(AlignedAllocator<U, ALIGN> const &) {}
+
+  T *allocate(std::size_t n);
+  void deallocate(T *p, std::size_t);
+};
+
+template <typename T, typename U, std::size_t ALIGN>
+bool operator==(AlignedAllocator<T, ALIGN> const &,
+                AlignedAllocator<U, ALIGN> const &) {
+  return true;
+}
+
+template <typename T, typename U, std::size_t ALIGN>
+bool operator!=(AlignedAllocator<T, ALIGN> const &,
+                AlignedAllocator<U, ALIGN> const &) {
+  return false;
+}
+
+// INLINE DEFINITIONS //
+
+template <typename T, std::size_t ALIGN>
+T *AlignedAllocator<T, ALIGN>::allocate(std::size_t n) {
+  void *p = nullptr;
+  if (posix_memalign(&p, ALIGN, n * sizeof(T)) != 0)
+    throw std::bad_alloc();
+  return static_cast<T *>(p);
+}
+
+template <typename T, std::size_t ALIGN>
+void AlignedAllocator<T, ALIGN>::deallocate(T *p, std::size_t) {
+  free(p);
+}
+
+#endif // ALIGNED_ALLOCATOR_H
@@ -0,0 +1,226 @@
+/**
+ * File:	BoidSystem.h
+ *
+ * Summary:
+ *
+ * Structure-of-arrays storage for the flock. Position, velocity and heading
+ * are kept as separate float arrays per component, and the kind of boid is
+ * a single byte, so a loop that only needs positions and types only pulls
+ * those into cache.
+ *
+ * The moving state is double buffered. A step reads the front state
+ * through the usual accessors, writes every boid of the back state through
+ * back(), then swap() makes the back the front. Nothing is copied, and
+ * since no boid reads what another one writes, boids can be updated in any
+ * order or on any thread.
+ *
+ * A boid's index is only its slot in the arrays. permute() moves boids
+ * between slots, e.g. to keep boids close in space close in memory, and
+ * id() and slot() map between slots and ids that stay with a boid.
+ */
+
+#ifndef BOID_SYSTEM_H
+#define BOID_SYSTEM_H
+
+#include <vector>
+
+#include "Vec3f.h"
+#include "AlignedAllocator.h"
+
+class ThreadPool;
+
+class BoidSystem {
+public:
+  enum Type : unsigned char { PREY = 0, PREDATOR = 1 };
+
+  // alignment of every array, wide enough for 8-float vector loads
+  enum { ALIGN = 32 };
+
+  typedef std::vector<float, AlignedAllocator<float, ALIGN>> FloatArray;
+  typedef std::vector<unsigned char, AlignedAllocator<unsigned char, ALIGN>>
+      TypeArray;
+
+  // Writable view of one state buffer
+  struct Arrays {
+    float *x, *y, *z;
+    float *vx, *vy, *vz;
+    float *hx, *hy, *hz;
+  };
+
+public:
+  BoidSystem();
+
+  void clear();
+  void reserve(unsigned n);
+  unsigned add(Vec3f const &position, Vec3f const &velocity, Type type);
+
+  unsigned size() const;
+  bool empty() const;
+
+  // Indices of every PREDATOR, in slot order
+  std::vector<unsigned> const &predators() const;
+
+  // Id of the boid in slot i, the slot add() gave it, and back
+  unsigned id(unsigned i) const;
+  unsigned slot(unsigned id) const;
+
+  // Moves the boid in slot order[k] to slot k, for every k. Front state,
+  // types and ids move, the back state is left for the next step to
+  // overwrite.
+  void permute(std::vector<unsigned> const &order, ThreadPool &pool);
+  // Bumped by every permute(), for whoever keeps per slot copies
+  unsigned long layout() const;
+
+  // Per boid access to the front state, for setup and rendering
+  Vec3f position(unsigned i) const;
+  void setPosition(unsigned i, Vec3f const &p);
+  Vec3f velocity(unsigned i) const;
+  void setVelocity(unsigned i, Vec3f const &v);
+  Vec3f heading(unsigned i) const; // unit direction of travel, or zero
+  void setHeading(unsigned i, Vec3f const &h);
+  Type type(unsigned i) const;
+  bool isPredator(unsigned i) const;
+
+  // Raw front arrays, for the hot loops
+  float *x();
+  float *y();
+  float *z();
+  float *vx();
+  float *vy();
+  float *vz();
+  float *hx();
+  float *hy();
+  float *hz();
+  unsigned char *types();
+  float const *x() const;
+  float const *y() const;
+  float const *z() const;
+  float const *vx() const;
+  float const *vy() const;
+  float const *vz() const;
+  float const *hx() const;
+  float const *hy() const;
+  float const *hz() const;
+  unsigned char const *types() const;
+
+  // The state the current step writes, every field of every boid
+  Arrays back();
+  // Back becomes front, the old front is overwritten by the next step
+  void swap();
+
+private:
+  struct State {
+    FloatArray x, y, z;
+    FloatArray vx, vy, vz;
+    FloatArray hx, hy, hz;
+  };
+
+  State &front();
+  State const &front() const;
+
+private:
+  State m_state[2];
+  unsigned m_front;
+  TypeArray m_type;
+  std::vector<unsigned> m_predators;
+  std::vector<unsigned> m_id;   // per slot
+  std::vector<unsigned> m_slot; // per id
+  unsigned long m_layout;
+};
+
+// INLINE DEFINITIONS //
+
+inline BoidSystem::BoidSystem() : m_front(0), m_layout(0) {}
+
+inline unsigned BoidSystem::size() const { return m_type.size(); }
+inline bool BoidSystem::empty() const { return m_type.empty(); }
+
+inline std::vector<unsigned> const &BoidSystem::predators() const {
+  return m_predators;
+}
+
+inline unsigned BoidSystem::id(unsigned i) const { return m_id[i]; }
+inline unsigned BoidSystem::slot(unsigned id) const { return m_slot[id]; }
+inline unsigned long BoidSystem::layout() const { return m_layout; }
+
+inline BoidSystem::State &BoidSystem::front() { return m_state[m_front]; }
+
+inline BoidSystem::State const &BoidSystem::front() const {
+  return m_state[m_front];
+}
+
+inline Vec3f BoidSystem::position(unsigned i) const {
+  State const &s = front();
+  return Vec3f(s.x[i], s.y[i], s.z[i]);
+}
+
+inline void BoidSystem::setPosition(unsigned i, Vec3f const &p) {
+  State &s = front();
+  s.x[i] = p.x();
+  s.y[i] = p.y();
+  s.z[i] = p.z();
+}
+
+inline Vec3f BoidSystem::velocity(unsigned i) const {
+  State const &s = front();
+  return Vec3f(s.vx[i], s.vy[i], s.vz[i]);
+}
+
+inline void BoidSystem::setVelocity(unsigned i, Vec3f const &v) {
+  State &s = front();
+  s.vx[i] = v.x();
+  s.vy[i] = v.y();
+  s.vz[i] = v.z();
+}
+
+inline Vec3f BoidSystem::heading(unsigned i) const {
+  State const &s = front();
+  return Vec3f(s.hx[i], s.hy[i], s.hz[i]);
+}
+
+inline void BoidSystem::setHeading(unsigned i, Vec3f const &h) {
+  State &s = front();
+  s.hx[i] = h.x();
+  s.hy[i] = h.y();
+  s.hz[i] = h.z();
+}
+
+inline BoidSystem::Type BoidSystem::type(unsigned i) const {
+  return Type(m_type[i]);
+}
+
+inline bool BoidSystem::isPredator(unsigned i) const {
+  return m_type[i] == PREDATOR;
+}
+
+inline float *BoidSystem::x() { return front().x.data(); }
+inline float *BoidSystem::y() { return front().y.data(); }
+inline float *BoidSystem::z() { return front().z.data(); }
+inline float *BoidSystem::vx() { return front().vx.data(); }
+inline float *BoidSystem::vy() { return front().vy.data(); }
+inline float *BoidSystem::vz() { return front().vz.data(); }
+inline float *BoidSystem::hx() { return front().hx.data(); }
+inline float *BoidSystem::hy() { return front().hy.data(); }
+inline float *BoidSystem::hz() { return front().hz.data(); }
+inline unsigned char *BoidSystem::types() { return m_type.data(); }
+inline float const *BoidSystem::x() const { return front().x.data(); }
+inline float const *BoidSystem::y() const { return front().y.data(); }
+inline float const *BoidSystem::z() const { return front().z.data(); }
+inline float const *BoidSystem::vx() const { return front().vx.data(); }
+inline float const *BoidSystem::vy() const { return front().vy.data(); }
+inline float const *BoidSystem::vz() const { return front().vz.data(); }
+inline float const *BoidSystem::hx() const { return front().hx.data(); }
+inline float const *BoidSystem::hy() const { return front().hy.data(); }
+inline float const *BoidSystem::hz() const { return front().hz.data(); }
+inline unsigned char const *BoidSystem::types() const { return m_type.data(); }
+
+inline BoidSystem::Arrays BoidSystem::back() {
+  State &s = m_state[m_front ^ 1];
+  Arrays a = {s.x.data(),  s.y.data(),  s.z.data(),  s.vx.data(), s.vy.data(),
+              s.vz.data(), s.hx.data(), s.hy.data(), s.hz.data()};
+  return a;
+}
+
+inline void BoidSystem::swap() { m_front ^= 1; }
+
+#endif // BOID_SYSTEM_H
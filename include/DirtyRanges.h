@@ -0,0 +1,53 @@
+/**
+ * File:	DirtyRanges.h
+ *
+ * Summary:
+ *
+ * The boid indices written since a consumer last looked, kept as a short
+ * sorted list of half open ranges. Ranges that overlap or touch are merged
+ * as they are added. Past MAX_RANGES the two with the smallest gap between
+ * them are merged too, so a consumer uploading one range at a time never
+ * makes more than MAX_RANGES calls, at the cost of rewriting a few clean
+ * indices.
+ */
+
+#ifndef DIRTY_RANGES_H
+#define DIRTY_RANGES_H
+
+#include <vector>
+
+class DirtyRanges {
+public:
+  enum { MAX_RANGES = 16 };
+
+  struct Range {
+    unsigned begin, end; // end is one past the last index
+  };
+
+public:
+  DirtyRanges();
+
+  void add(unsigned begin, unsigned end);
+  void clear();
+
+  bool empty() const;
+  // sorted, disjoint and never touching
+  std::vector<Range> const &ranges() const;
+  unsigned count() const; // indices covered
+
+private:
+  std::vector<Range> m_ranges;
+};
+
+// INLINE DEFINITIONS //
+
+inline DirtyRanges::DirtyRanges() {}
+
+inline void DirtyRanges::clear() { m_ranges.clear(); }
+inline bool DirtyRanges::empty() const { return m_ranges.empty(); }
+
+inline std::vector<DirtyRanges::Range> const &DirtyRanges::ranges() const {
+  return m_ranges;
+}
+
+#endif // DIRTY_RANGES_H
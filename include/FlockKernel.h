@@ -0,0 +1,92 @@
+/**
+ * File:	FlockKernel.h
+ *
+ * Summary:
+ *
+ * The inner loop of animateQuad: for one boid, walk a list of candidate
+ * neighbours and accumulate the flocking sums (cohesion, alignment and the
+ * separation vector). Only prey is flocked with. Fleeing predators is a
+ * separate pass over the few predators, and walls are not boids, see
+ * Obstacles.
+ *
+ * There is a scalar, an SSE4.2 and an AVX2 build of the loop. Each vector
+ * build lives in its own translation unit compiled with the matching -m
+ * flag, and the one to use is picked from cpuid when the program starts.
+ * Set BOIDS_KERNEL=scalar|sse42|avx2 to force one, e.g. for benchmarking.
+ *
+ * The kernel translation units must not call inline functions from shared
+ * headers, otherwise the linker may keep their AVX2 copy for everyone.
+ */
+
+#ifndef FLOCK_KERNEL_H
+#define FLOCK_KERNEL_H
+
+#include "BoidSystem.h"
+
+// Read only view of the flock arrays
+struct FlockSpan {
+  float const *x, *y, *z;
+  float const *vx, *vy, *vz;
+  unsigned char const *type; // BoidSystem::Type
+};
+
+// The boid doing the looking
+struct FlockQuery {
+  float px, py, pz;
+  float hx, hy, hz; // unit heading
+  bool seeing;      // false if the heading is zero, then nothing is seen
+};
+
+struct FlockRules {
+  float follow;     // fol, radius for cohesion and alignment
+  float avoid;      // avo, radius for separation
+  float cosHalfFov; // cos of half the field of view
+};
+
+struct FlockSums {
+  float position[3]; // sum of followed neighbour positions
+  float velocity[3]; // sum of followed neighbour velocities
+  float avoid[3];    // separation vector, already scaled
+  int count;         // number of followed neighbours
+};
+
+typedef void (*FlockKernel)(FlockSpan const &span, unsigned const *indices,
+                            unsigned count, FlockQuery const &query,
+                            FlockRules const &rules, FlockSums &sums);
+
+enum FlockKernelVariant { KERNEL_SCALAR, KERNEL_SSE42, KERNEL_AVX2 };
+
+void flockKernelScalar(FlockSpan const &span, unsigned const *indices,
+                       unsigned count, FlockQuery const &query,
+                       FlockRules const &rules, FlockSums &sums);
+void flockKernelSSE42(FlockSpan const &span, unsigned const *indices,
+                      unsigned count, FlockQuery const &query,
+                      FlockRules const &rules, FlockSums &sums);
+void flockKernelAVX2(FlockSpan const &span, unsigned const *indices,
+                     unsigned count, FlockQuery const &query,
+                     FlockRules const &rules, FlockSums &sums);
+
+// Best variant this cpu runs, unless BOIDS_KERNEL says otherwise
+FlockKernelVariant chooseFlockKernel();
+bool flockKernelSupported(FlockKernelVariant variant);
+
+// The variant in use, chosen once at startup
+FlockKernelVariant flockKernelVariant();
+void setFlockKernelVariant(FlockKernelVariant variant);
+FlockKernel flockKernel();
+
+char const *flockKernelName(FlockKernelVariant variant);
+
+// Scale applied to q - p for each kind of avoidance, walls included
+enum { AVOID_PREY_DIV = 50, AVOID_PREDATOR_DIV = 25, AVOID_WALL_DIV = 10 };
+
+// predators are 10 times scarier than colliding with prey
+enum { PREDATOR_RANGE_SCALE = 10 };
+
+inline FlockSpan flockSpan(BoidSystem const &boids) {
+  FlockSpan span = {boids.x(),  boids.y(),  boids.z(),    boids.vx(),
+                    boids.vy(), boids.vz(), boids.types()};
+  return span;
+}
+
+#endif // FLOCK_KERNEL_H
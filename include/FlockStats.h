@@ -0,0 +1,32 @@
+/**
+ * File:	FlockStats.h
+ *
+ * Summary:
+ *
+ * Flock wide aggregates, computed once per step by a parallel reduction
+ * over the front state instead of being re-summed inside per boid loops.
+ * Behaviour rules and the on screen overlay both read from the same
+ * FlockStats.
+ */
+
+#ifndef FLOCK_STATS_H
+#define FLOCK_STATS_H
+
+#include "BoidSystem.h"
+#include "ThreadPool.h"
+#include "Vec3f.h"
+
+struct FlockStats {
+  unsigned count;        // every boid
+  unsigned typeCount[2]; // indexed by BoidSystem::Type
+  Vec3f centroid;        // mean position
+  Vec3f meanVelocity;
+  Vec3f boundsMin; // bounding box of the positions, both zero when empty
+  Vec3f boundsMax;
+};
+
+// Boids are reduced in fixed size chunks whose partials are combined in
+// order, so the result does not depend on the number of threads.
+FlockStats computeFlockStats(BoidSystem const &boids, ThreadPool &pool);
+
+#endif // FLOCK_STATS_H
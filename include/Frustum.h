@@ -0,0 +1,35 @@
+/**
+ * File:	Frustum.h
+ *
+ * Summary:
+ *
+ * The six planes of a view frustum, taken from the rows of a projection
+ * times view matrix, for testing boxes against what the camera sees.
+ */
+
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include "Mat4f.h"
+#include "Vec3f.h"
+
+class Frustum {
+public:
+  enum Side { OUTSIDE = -1, PARTIAL = 0, INSIDE = 1 };
+
+public:
+  // Everything visible, until set from a matrix
+  Frustum();
+  explicit Frustum(Mat4f const &viewProjection);
+
+  // Where the axis aligned box lo..hi is. Conservative: a box near a
+  // corner of the frustum can be PARTIAL while all of it is outside.
+  Side classify(Vec3f const &lo, Vec3f const &hi) const;
+
+private:
+  // inside where dot(normal, p) + d >= 0, the normals are not normalized
+  Vec3f m_normal[6];
+  float m_d[6];
+};
+
+#endif // FRUSTUM_H
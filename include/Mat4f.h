@@ -22,27 +22,34 @@
 #include <iterator>
 #include <iostream>
 
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
 // Stores a 4 by 4 Matrix in Row Major order.
 // When passing to glUniform4x4fv, turn on transpose.
+//
+// The 16 floats are held inline, 16 byte aligned, so a Mat4f is a plain
+// value: temporaries in P * V * M cost no allocation, copies are a memcpy.
 
 class Mat4f {
 public:
   enum { DIM = 4, NUM_ELEM = 16 };
 
   typedef std::array<float, NUM_ELEM> ARRAY_16f;
-  typedef std::unique_ptr<ARRAY_16f> Mat4fHandle;
 
 public:
-  explicit Mat4f();
-  explicit Mat4f(float f);
+  // all zero
+  constexpr explicit Mat4f();
+  constexpr explicit Mat4f(float f);
+  // row by row, usable in constant expressions
+  constexpr Mat4f(float a00, float a01, float a02, float a03, //
+                  float a10, float a11, float a12, float a13, //
+                  float a20, float a21, float a22, float a23, //
+                  float a30, float a31, float a32, float a33);
 
   // not explicit, so Mat4f m = {1,...,16};
   Mat4f(std::initializer_list<float> list);
-  // Move constructor
-  Mat4f(Mat4f &&moved);
-  // Copy Constructor
-  Mat4f(const Mat4f &copied);
-  ~Mat4f();
 
   float &operator()(int row, int column);
   float &operator[](int element);
@@ -55,9 +62,6 @@ public:
   Mat4f operator*(const Mat4f &other) const;
   Mat4f operator*(float scalar) const;
 
-  Mat4f &operator=(const Mat4f &copied);
-  Mat4f &operator=(Mat4f &&moved);
-
   bool isValidDimIndex(int idx) const;
   bool isValidElementIndex(int idx) const;
 
@@ -71,9 +75,105 @@ public:
   float const *data() const;
 
 private:
-  Mat4fHandle m_ptr;
+  alignas(16) ARRAY_16f m_data;
 };
 
 std::ostream &operator<<(std::ostream &, const Mat4f &mat);
 
+// INLINE DEFINITIONS //
+
+constexpr Mat4f::Mat4f() : m_data{{}} {}
+
+constexpr Mat4f::Mat4f(float f)
+    : m_data{{f, f, f, f, f, f, f, f, f, f, f, f, f, f, f, f}} {}
+
+constexpr Mat4f::Mat4f(float a00, float a01, float a02, float a03, //
+                       float a10, float a11, float a12, float a13, //
+                       float a20, float a21, float a22, float a23, //
+                       float a30, float a31, float a32, float a33)
+    : m_data{{a00, a01, a02, a03, a10, a11, a12, a13, a20, a21, a22, a23, a30,
+              a31, a32, a33}} {}
+
+inline Mat4f::Mat4f(std::initializer_list<float> list) {
+  assert(list.size() == NUM_ELEM);
+  std::copy_n(list.begin(), NUM_ELEM, m_data.begin());
+}
+
+inline bool Mat4f::isValidDimIndex(int idx) const {
+  return idx >= 0 && idx < DIM;
+}
+
+inline bool Mat4f::isValidElementIndex(int idx) const {
+  return idx >= 0 && idx < NUM_ELEM;
+}
+
+inline float &Mat4f::operator()(int row, int column) {
+  assert(isValidDimIndex(row) && isValidDimIndex(column));
+  return m_data[row * DIM + column];
+}
+
+inline float Mat4f::operator()(int row, int column) const {
+  assert(isValidDimIndex(row) && isValidDimIndex(column));
+  return m_data[row * DIM + column];
+}
+
+inline float &Mat4f::operator[](int element) {
+  assert(isValidElementIndex(element));
+  return m_data[element];
+}
+
+inline float Mat4f::operator[](int element) const {
+  assert(isValidElementIndex(element));
+  return m_data[element];
+}
+
+// Row i of the product is the rows of other weighted by row i of this.
+// Both versions add in the same order, so they give the same bits.
+inline Mat4f Mat4f::operator*(const Mat4f &other) const {
+  Mat4f result;
+  float const *a = m_data.data();
+  float const *b = other.m_data.data();
+  float *c = result.m_data.data();
+
+#ifdef __SSE__
+  __m128 b0 = _mm_load_ps(b);
+  __m128 b1 = _mm_load_ps(b + 4);
+  __m128 b2 = _mm_load_ps(b + 8);
+  __m128 b3 = _mm_load_ps(b + 12);
+  for (int i = 0; i < DIM; ++i) {
+    __m128 row = _mm_mul_ps(_mm_set1_ps(a[4 * i]), b0);
+    row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(a[4 * i + 1]), b1));
+    row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(a[4 * i + 2]), b2));
+    row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(a[4 * i + 3]), b3));
+    _mm_store_ps(c + 4 * i, row);
+  }
+#else
+  for (int i = 0; i < DIM; ++i) {
+    for (int j = 0; j < DIM; ++j) {
+      float element = a[4 * i] * b[j];
+      for (int k = 1; k < DIM; ++k)
+        element += a[4 * i + k] * b[4 * k + j];
+      c[4 * i + j] = element;
+    }
+  }
+#endif
+
+  return result;
+}
+
+inline void Mat4f::fill(float t) { m_data.fill(t); }
+
+inline float const *Mat4f::data() const { return m_data.data(); }
+
+inline Mat4f::ARRAY_16f::iterator Mat4f::begin() { return m_data.begin(); }
+inline Mat4f::ARRAY_16f::iterator Mat4f::end() { return m_data.end(); }
+
+inline Mat4f::ARRAY_16f::const_iterator Mat4f::begin() const {
+  return m_data.begin();
+}
+
+inline Mat4f::ARRAY_16f::const_iterator Mat4f::end() const {
+  return m_data.end();
+}
+
 #endif // MAT4F_H
@@ -0,0 +1,52 @@
+/**
+ * File:	MortonOrder.h
+ *
+ * Summary:
+ *
+ * Z-order of the flock. Each boid's position within the flock bounds is
+ * quantised to 10 bits per axis and the bits interleaved into a 30 bit
+ * Morton code, so boids with close codes are close in space. Sorting the
+ * slots by code and permuting the boids into that order makes a
+ * neighbour's data likely to share a cache line, or at least a page, with
+ * the boid looking at it, where the order boids were created in scatters
+ * them over the whole flock.
+ *
+ * The codes are sorted with a least significant digit radix sort, 8 bits
+ * a pass, each pass a histogram per chunk, a prefix sum over the chunks
+ * and a stable scatter, the chunks on the pool.
+ */
+
+#ifndef MORTON_ORDER_H
+#define MORTON_ORDER_H
+
+#include <vector>
+
+#include "BoidSystem.h"
+#include "ThreadPool.h"
+#include "Vec3f.h"
+
+class MortonOrder {
+public:
+  enum {
+    BITS = 10,           // per axis
+    DIGIT_BITS = 8,      // per radix pass
+    CHUNK = 1 << 14      // boids per task
+  };
+
+  // Code of p inside lo..hi, clamped to it
+  static unsigned code(Vec3f const &p, Vec3f const &lo, Vec3f const &hi);
+
+public:
+  // Slots of boids sorted by the code of their position inside lo..hi,
+  // ties in slot order. What BoidSystem::permute() takes.
+  std::vector<unsigned> const &compute(BoidSystem const &boids,
+                                       Vec3f const &lo, Vec3f const &hi,
+                                       ThreadPool &pool);
+
+private:
+  std::vector<unsigned> m_codes[2]; // sorted in step with m_order
+  std::vector<unsigned> m_order[2];
+  std::vector<unsigned> m_counts; // per chunk, a count per digit
+};
+
+#endif // MORTON_ORDER_H
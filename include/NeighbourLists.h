@@ -0,0 +1,205 @@
+/**
+ * File:	NeighbourLists.h
+ *
+ * Summary:
+ *
+ * Verlet neighbour lists. Each prey boid keeps the prey within the follow
+ * reach plus a skin, found once through the spatial index and then reused
+ * for as many steps as it stays exact. A boid that is within reach now
+ * was within reach + skin when the lists were built as long as no boid
+ * has moved more than skin/2 since, so the lists only need rebuilding
+ * once one has. Boids move at most a unit or so per step against a reach
+ * of about 80, so most steps just walk the lists.
+ *
+ * Predators are left out. The flocking kernel skips them as neighbours,
+ * they move three times as fast as prey and would force a rebuild every
+ * few steps, and there are few of them to query the index for directly.
+ *
+ * Past MAX_ENTRIES the lists are dropped rather than built, a flock packed
+ * that densely has as many real neighbours as candidates anyway.
+ */
+
+#ifndef NEIGHBOUR_LISTS_H
+#define NEIGHBOUR_LISTS_H
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "BoidSystem.h"
+#include "ThreadPool.h"
+
+class NeighbourLists {
+public:
+  enum {
+    MAX_ENTRIES = 1 << 26, // 256 MB of indices
+    CHUNK = 256            // boids per chunk of a parallel build
+  };
+
+  // What build() hands the candidates function, to call once per run of
+  // candidates. Keeps the prey within the radius.
+  struct Collect {
+    float const *x, *y, *z;
+    unsigned char const *types;
+    Vec3f p;
+    float r2;
+    std::vector<unsigned> *list;
+
+    void operator()(unsigned const *indices, unsigned count) const;
+  };
+
+public:
+  NeighbourLists();
+
+  // Forget the lists, the next stale() is true
+  void clear();
+
+  // True when the lists can't be trusted for this flock and reach: never
+  // built, built for another flock size or reach, or some prey has moved
+  // more than skin/2 since.
+  bool stale(BoidSystem const &boids, float reach, float skin,
+             ThreadPool &pool);
+
+  // Lists for every prey boid, from the runs candidates(p, radius,
+  // collect) calls collect(indices, count) with, which must hold every
+  // boid within radius of p. One chunk of boids per task, the chunks
+  // joined after.
+  template <typename Candidates>
+  void build(BoidSystem const &boids, float reach, float skin,
+             ThreadPool &pool, Candidates candidates);
+
+  // False when the last build gave up at MAX_ENTRIES
+  bool usable() const;
+
+  // Calls fn(indices, count) once with prey boid i's list, the boids
+  // within reach + skin of it at the last build, itself included
+  template <typename Fn>
+  void forEachSpanOf(unsigned i, Fn fn) const;
+
+  unsigned long long entries() const;
+  unsigned long long builds() const;
+
+private:
+  std::vector<unsigned> m_start;   // boid i's list is m_start[i] .. [i + 1]
+  std::vector<unsigned> m_indices; // every list, back to back
+  std::vector<std::vector<unsigned>> m_chunks; // per chunk, while building
+  std::vector<float> m_chunkMoved;             // per chunk, in stale()
+  BoidSystem::FloatArray m_x, m_y, m_z;        // positions at the build
+
+  float m_reach, m_skin;
+  bool m_built;
+  bool m_usable;
+  unsigned long long m_builds;
+};
+
+// INLINE DEFINITIONS //
+
+inline NeighbourLists::NeighbourLists()
+    : m_reach(0), m_skin(0), m_built(false), m_usable(false), m_builds(0) {}
+
+inline bool NeighbourLists::usable() const { return m_usable; }
+inline unsigned long long NeighbourLists::entries() const {
+  return m_usable ? m_indices.size() : 0;
+}
+inline unsigned long long NeighbourLists::builds() const { return m_builds; }
+
+inline void NeighbourLists::Collect::operator()(unsigned const *indices,
+                                                unsigned count) const {
+  for (unsigned k = 0; k < count; k++) {
+    unsigned j = indices[k];
+    float dx = x[j] - p.x(), dy = y[j] - p.y(), dz = z[j] - p.z();
+    if (types[j] == BoidSystem::PREY && dx * dx + dy * dy + dz * dz <= r2)
+      list->push_back(j);
+  }
+}
+
+template <typename Candidates>
+void NeighbourLists::build(BoidSystem const &boids, float reach, float skin,
+                           ThreadPool &pool, Candidates candidates) {
+  unsigned n = boids.size();
+  float radius = reach + skin;
+  float const *x = boids.x(), *y = boids.y(), *z = boids.z();
+  unsigned char const *types = boids.types();
+
+  unsigned numChunks = (n + CHUNK - 1) / CHUNK;
+  m_chunks.resize(numChunks);
+  m_start.resize(n + 1);
+
+  // chunks check the running total as they go and give up past the limit
+  std::atomic<unsigned long long> total(0);
+  std::atomic<bool> tooMany(false);
+
+  pool.parallelFor(numChunks, 1, [&](unsigned begin, unsigned end) {
+    for (unsigned c = begin; c < end && !tooMany; c++) {
+      std::vector<unsigned> &list = m_chunks[c];
+      list.clear();
+
+      Collect collect;
+      collect.x = x;
+      collect.y = y;
+      collect.z = z;
+      collect.types = types;
+      collect.r2 = radius * radius;
+      collect.list = &list;
+
+      unsigned first = c * CHUNK;
+      unsigned last = std::min(first + CHUNK, n);
+      for (unsigned i = first; i < last; i++) {
+        // relative to the chunk until the chunks are joined
+        m_start[i] = list.size();
+        if (types[i] != BoidSystem::PREY)
+          continue;
+
+        collect.p = boids.position(i);
+        candidates(collect.p, radius, collect);
+      }
+
+      if ((total += list.size()) > MAX_ENTRIES)
+        tooMany = true;
+    }
+  });
+
+  m_x.assign(x, x + n);
+  m_y.assign(y, y + n);
+  m_z.assign(z, z + n);
+  m_reach = reach;
+  m_skin = skin;
+  m_built = true;
+  m_builds++;
+
+  m_usable = !tooMany;
+  if (!m_usable) {
+    // the positions are still kept, so the next try waits for a move of
+    // skin/2 like a rebuild would
+    m_indices.clear();
+    m_indices.shrink_to_fit();
+    for (std::vector<unsigned> &list : m_chunks)
+      std::vector<unsigned>().swap(list);
+    return;
+  }
+
+  std::vector<unsigned> offsets(numChunks + 1, 0);
+  for (unsigned c = 0; c < numChunks; c++)
+    offsets[c + 1] = offsets[c] + m_chunks[c].size();
+  m_indices.resize(offsets[numChunks]);
+  m_start[n] = offsets[numChunks];
+
+  pool.parallelFor(numChunks, 1, [&](unsigned begin, unsigned end) {
+    for (unsigned c = begin; c < end; c++) {
+      std::copy(m_chunks[c].begin(), m_chunks[c].end(),
+                m_indices.begin() + offsets[c]);
+      unsigned last = std::min((c + 1) * CHUNK, n);
+      for (unsigned i = c * CHUNK; i < last; i++)
+        m_start[i] += offsets[c];
+    }
+  });
+}
+
+template <typename Fn>
+void NeighbourLists::forEachSpanOf(unsigned i, Fn fn) const {
+  unsigned count = m_start[i + 1] - m_start[i];
+  if (count > 0)
+    fn(&m_indices[m_start[i]], count);
+}
+
+#endif // NEIGHBOUR_LISTS_H
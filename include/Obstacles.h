@@ -0,0 +1,54 @@
+/**
+ * File:	Obstacles.h
+ *
+ * Summary:
+ *
+ * Static obstacles boids steer around, kept out of the flock. Each one is
+ * a line segment, boids are pushed away from the closest point on it. The
+ * list is short and fixed, so the query costs the same no matter how many
+ * boids there are, and the geometry only needs uploading once.
+ */
+
+#ifndef OBSTACLES_H
+#define OBSTACLES_H
+
+#include <vector>
+
+#include "Vec3f.h"
+
+class Obstacles {
+public:
+  struct Segment {
+    Vec3f a;
+    Vec3f b;
+  };
+
+public:
+  void clear();
+  void addSegment(Vec3f const &a, Vec3f const &b);
+
+  unsigned size() const;
+  bool empty() const;
+  Segment const &segment(unsigned i) const;
+
+  // Closest point to p on segment i
+  Vec3f closestPoint(unsigned i, Vec3f const &p) const;
+
+  // Sum of p - c over every segment whose closest point c is within range
+  // of p. Zero if nothing is that close.
+  Vec3f avoidance(Vec3f const &p, float range) const;
+
+private:
+  std::vector<Segment> m_segments;
+};
+
+// INLINE DEFINITIONS //
+
+inline unsigned Obstacles::size() const { return m_segments.size(); }
+inline bool Obstacles::empty() const { return m_segments.empty(); }
+
+inline Obstacles::Segment const &Obstacles::segment(unsigned i) const {
+  return m_segments[i];
+}
+
+#endif // OBSTACLES_H
@@ -0,0 +1,190 @@
+/**
+ * File:	Octree.h
+ *
+ * Summary:
+ *
+ * Adaptive octree over boid positions, rebuilt from scratch every step.
+ * Nodes split at the middle of the tight bounds of the boids under them
+ * until a node holds LEAF_SIZE boids or fewer, so dense clusters get deep
+ * small leaves and empty space gets no nodes at all, where a uniform grid
+ * has the same cell size everywhere.
+ *
+ * Boids are partitioned in place as the tree is built, so the boids under
+ * any node, not only a leaf, are one contiguous run of indices. A radius
+ * query hands a node that lies entirely inside the sphere over as a
+ * single span, and only opens the nodes the sphere's surface crosses.
+ *
+ * In a dense cluster the sphere crosses most of the cluster's nodes, and
+ * walking them for every boid costs more than the candidates it saves. So
+ * the step's own query, every boid at one radius, is answered per leaf:
+ * build() finds the runs within reach of each leaf's box in one pass down
+ * the tree, and a boid replays the runs of its leaf.
+ */
+
+#ifndef OCTREE_H
+#define OCTREE_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "Vec3f.h"
+
+class Octree {
+public:
+  enum {
+    LEAF_SIZE = 16, // boids a node may hold before it is split
+    MAX_DEPTH = 16, // deep enough for any flock, stops coincident boids
+    NO_LEAF = ~0u   // leaf of a boid left out of the tree
+  };
+
+public:
+  Octree();
+
+  // Boids with a position that is not finite are left out, a distance
+  // test against them fails anyway. radius is the one forEachSpanOf()
+  // answers.
+  void build(float const *x, float const *y, float const *z, unsigned n,
+             float radius);
+
+  // Calls fn(indices, count) for runs holding every boid within the build
+  // radius of boid i, the runs of the nodes within reach of i's leaf. A
+  // few more candidates than forEachSpan() around i, with no tree walk.
+  template <typename Fn>
+  void forEachSpanOf(unsigned i, Fn fn) const;
+
+  // Calls fn(indices, count) for runs of boids that together hold every
+  // boid within radius of p, from the nodes whose bounds reach the sphere.
+  // Callers still need to test the distance.
+  template <typename Fn>
+  void forEachSpan(Vec3f const &p, float radius, Fn fn) const;
+
+  // Same boids as forEachSpan, one fn(j) each
+  template <typename Fn>
+  void forEachNear(Vec3f const &p, float radius, Fn fn) const;
+
+  unsigned numNodes() const;
+  unsigned depth() const;
+
+private:
+  struct Node {
+    Vec3f lo, hi;        // tight bounds of the boids under the node
+    unsigned begin, end; // those boids, a run of m_indices
+    unsigned firstChild; // children are contiguous, none when 0
+    unsigned numChildren;
+    unsigned firstRun, numRuns; // a leaf's runs for forEachSpanOf()
+  };
+
+  struct Run {
+    unsigned begin, end;
+  };
+
+  void split(unsigned node, unsigned depth, float const *const axes[3]);
+  void findLeafRuns(float radius);
+  void gatherRuns(unsigned node, unsigned from, float r2);
+  void keepInReach(Node const &node, unsigned other, float r2,
+                   unsigned levels);
+
+  // Calls fn(begin, end) for the runs of m_indices under the nodes
+  // classify(node) does not put outside, in index order and joined where
+  // they touch. classify returns < 0 for outside, > 0 to take the whole
+  // node, 0 to open it.
+  template <typename Classify, typename Fn>
+  void forEachRun(Classify classify, Fn fn) const;
+
+private:
+  std::vector<Node> m_nodes; // m_nodes[0] is the root
+  std::vector<unsigned> m_indices;
+  std::vector<unsigned> m_scratch;      // partition buffers for build
+  std::vector<unsigned char> m_octant;
+  unsigned m_depth;
+
+  std::vector<unsigned> m_leafOf; // per boid, its leaf, or NO_LEAF
+  std::vector<Run> m_runs;        // every leaf's runs, back to back
+  std::vector<unsigned> m_reach;  // gatherRuns' stack of nodes in reach
+};
+
+// INLINE DEFINITIONS //
+
+inline Octree::Octree() : m_depth(0) {}
+
+inline unsigned Octree::numNodes() const { return m_nodes.size(); }
+inline unsigned Octree::depth() const { return m_depth; }
+
+template <typename Classify, typename Fn>
+void Octree::forEachRun(Classify classify, Fn fn) const {
+  if (m_nodes.empty())
+    return;
+
+  unsigned runBegin = 0, runEnd = 0;
+
+  // at most 7 siblings are left waiting per level, plus the one popped
+  unsigned stack[MAX_DEPTH * 7 + 8];
+  unsigned top = 0;
+  stack[top++] = 0;
+
+  while (top > 0) {
+    Node const &node = m_nodes[stack[--top]];
+
+    int side = classify(node);
+    if (side < 0)
+      continue;
+    if (side > 0 || node.numChildren == 0) {
+      if (node.begin != runEnd) {
+        if (runEnd > runBegin)
+          fn(runBegin, runEnd);
+        runBegin = node.begin;
+      }
+      runEnd = node.end;
+      continue;
+    }
+
+    // last child first, so the first is popped next
+    for (unsigned c = node.numChildren; c-- > 0;)
+      stack[top++] = node.firstChild + c;
+  }
+
+  if (runEnd > runBegin)
+    fn(runBegin, runEnd);
+}
+
+template <typename Fn>
+void Octree::forEachSpan(Vec3f const &p, float radius, Fn fn) const {
+  float r2 = radius * radius;
+  auto classify = [&](Node const &node) {
+    // nearest and furthest points of the bounds from p
+    float near2 = 0, far2 = 0;
+    for (int a = 0; a < 3; a++) {
+      float d = std::max(std::max(node.lo[a] - p[a], p[a] - node.hi[a]), 0.f);
+      float f = std::max(std::fabs(p[a] - node.lo[a]),
+                         std::fabs(p[a] - node.hi[a]));
+      near2 += d * d;
+      far2 += f * f;
+    }
+    return near2 > r2 ? -1 : far2 <= r2 ? 1 : 0;
+  };
+
+  forEachRun(classify, [&](unsigned begin, unsigned end) {
+    fn(&m_indices[begin], end - begin);
+  });
+}
+
+template <typename Fn>
+void Octree::forEachSpanOf(unsigned i, Fn fn) const {
+  if (i >= m_leafOf.size() || m_leafOf[i] == NO_LEAF)
+    return;
+
+  Node const &leaf = m_nodes[m_leafOf[i]];
+  for (unsigned r = leaf.firstRun; r < leaf.firstRun + leaf.numRuns; r++)
+    fn(&m_indices[m_runs[r].begin], m_runs[r].end - m_runs[r].begin);
+}
+
+template <typename Fn>
+void Octree::forEachNear(Vec3f const &p, float radius, Fn fn) const {
+  forEachSpan(p, radius, [&](unsigned const *indices, unsigned count) {
+    for (unsigned k = 0; k < count; k++)
+      fn(indices[k]);
+  });
+}
+
+#endif // OCTREE_H
@@ -0,0 +1,53 @@
+/**
+ * File:	PerfCounters.h
+ *
+ * Summary:
+ *
+ * Hardware cache counters through Linux perf_event_open, to see what a
+ * change to the memory layout does to cache misses and not only to the
+ * time. They count only the thread that made them, not the pool's
+ * workers, so a pool of one thread gives the whole picture. Where
+ * the kernel or the machine has no such counters, e.g. most virtual
+ * machines, available() is false and error() says why.
+ */
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <string>
+
+class PerfCounters {
+public:
+  enum Event {
+    CACHE_REFERENCES, // last level cache accesses
+    CACHE_MISSES,     // last level cache misses
+    L1D_READ_MISSES,
+    EVENTS
+  };
+
+  static char const *eventName(Event event);
+
+public:
+  PerfCounters();
+  ~PerfCounters();
+
+  PerfCounters(PerfCounters const &) = delete;
+  PerfCounters &operator=(PerfCounters const &) = delete;
+
+  // True if any of the events could be opened
+  bool available() const;
+  std::string const &error() const;
+  bool has(Event event) const;
+
+  // Zero and count from here, then stop counting. count() reads the
+  // events counted in between.
+  void start();
+  void stop();
+  unsigned long long count(Event event) const;
+
+private:
+  int m_fd[EVENTS]; // -1 for an event that could not be opened
+  std::string m_error;
+};
+
+#endif // PERF_COUNTERS_H
@@ -3,200 +3,324 @@
 
 #include <ostream>
 #include <cmath>
+#include <limits>
 #include "Vec3f.h"
 #include "Mat4f.h"
 
-class Quat4f {
+// Quaternion of any floating point type, re + im. Quat4f is the float one
+// the camera uses, Quat4d the double one.
+template <typename T> class Quat {
 public:
-  Quat4f(float real = 0, float iVal = 0, float jVal = 0, float kVal = 0);
-
-  Quat4f(float re, Vec3f const &im = Vec3f());
-  Quat4f(Vec3f const &im);
-
-  Quat4f const &operator=(float real);
-  Quat4f const &operator=(Vec3f const &vec);
-
-  float &operator[](int index);
-  float const &operator[](int index) const;
-
-  float &re();
-  float const &re() const;
-  Vec3f &im();
-  Vec3f const &im() const;
-
-  Quat4f operator+(Quat4f const &q) const;
-  Quat4f operator-(Quat4f const &q) const;
-  Quat4f operator-(void) const;
-  Quat4f operator*(float scalar) const;
-  Quat4f operator/(float scalar) const;
-
-  Quat4f operator*(Quat4f const &q) const;
-  Vec3f operator*(Vec3f const &v) const;
-  void operator*=(Quat4f const &q);
-  Quat4f operator~() const;
-  Quat4f inv() const;
-
-  void operator+=(Quat4f const &q);
-  void operator+=(float scalar);
-  void operator-=(Quat4f const &q);
-  void operator-=(float scalar);
-  void operator*=(float scalar);
-  void operator/=(float scalar);
-
-  float norm() const;
-  float normSquared() const;
-  Quat4f normalized() const;
+  typedef T value_type;
+
+public:
+  constexpr Quat(T real = 0, T iVal = 0, T jVal = 0, T kVal = 0);
+
+  constexpr Quat(T re, Vec3<T> const &im = Vec3<T>());
+  constexpr Quat(Vec3<T> const &im);
+
+  Quat const &operator=(T real);
+  Quat const &operator=(Vec3<T> const &vec);
+
+  T &operator[](int index);
+  T const &operator[](int index) const;
+
+  T &re();
+  constexpr T const &re() const;
+  Vec3<T> &im();
+  constexpr Vec3<T> const &im() const;
+
+  constexpr Quat operator+(Quat const &q) const;
+  constexpr Quat operator-(Quat const &q) const;
+  constexpr Quat operator-(void) const;
+  constexpr Quat operator*(T scalar) const;
+  constexpr Quat operator/(T scalar) const;
+
+  Quat operator*(Quat const &q) const;
+  Vec3<T> operator*(Vec3<T> const &v) const;
+  void operator*=(Quat const &q);
+  constexpr Quat operator~() const;
+  Quat inv() const;
+
+  void operator+=(Quat const &q);
+  void operator+=(T scalar);
+  void operator-=(Quat const &q);
+  void operator-=(T scalar);
+  void operator*=(T scalar);
+  void operator/=(T scalar);
+
+  T norm() const;
+  constexpr T normSquared() const;
+  Quat normalized() const;
   void normalize();
 
+  // always float, it is for GL
   Mat4f matrix4f() const;
 
+  friend constexpr Quat operator*(T scalar, Quat const &q) {
+    return q * scalar;
+  }
+
 private:
-  float m_re;
-  Vec3f m_im;
+  T m_re;
+  Vec3<T> m_im;
 };
 
-Quat4f operator*(float scalar, Quat4f const &q);
+typedef Quat<float> Quat4f;
+typedef Quat<double> Quat4d;
+
+// INLINE DEFINITIONS //
+
+template <typename T>
+std::ostream &operator<<(std::ostream &out, Quat<T> const &q) {
+  return out << q.re() << " " << q.im();
+}
+
+template <typename T>
+Quat<T> slerp(Quat<T> const &a, Quat<T> const &b,
+              typename Quat<T>::value_type t) {
+  //  float m0 = a.norm();
+  //  float m1 = b.norm();
+  //
+  //  float m = (1.0 - t) * m0 + t * m1;
+  //
+  //  Quat4f p0 = a / m0;
+  //  Quat4f p1 = b / m1;
+  //
+  //  float real = ((~p0) * p1).re();
+  //  if (real > 1.) {
+  //    real = 1.;
+  //  } else if (real < -1.) {
+  //    real = -1.;
+  //  }
+  //
+  //  float theta = std::acos(real);
+  //
+  //  float denom = std::sin(theta);
+  //  if (denom < std::numeric_limits<float>::epsilon()) {
+  //    denom = std::numeric_limits<float>::epsilon();
+  //  }
+  //
+  //  Quat4f p =
+  //      (std::sin((1.0 - t) * theta) * p0 + std::sin(t * theta) * p1) / denom;
+  //
+  //  return m * p;
+
+  T flip = 1;
+
+  T cosine = a.re() * b.re() + a.im() * b.im();
+
+  if (cosine < 0) {
+    cosine = -cosine;
+    flip = -1;
+  }
+
+  if ((1 - cosine) < std::numeric_limits<T>::epsilon())
+    return a * (1 - t) + b * (t * flip);
+
+  T theta = (T)acos(cosine);
+  T sine = (T)sin(theta);
+  T beta = (T)sin((1 - t) * theta) / sine;
+  T alpha = (T)sin(t * theta) / sine * flip;
+
+  return a * beta + b * alpha;
+}
 
-std::ostream &operator<<(std::ostream &out, Quat4f const &q);
+template <typename T>
+Vec3<T> rotateAround(Vec3<T> const &vec, Vec3<T> const &axis,
+                     typename Vec3<T>::value_type radians) {
+  radians *= 0.5;
+  const T sinAngle = std::sin(radians);
+  const T cosAngle = std::cos(radians);
 
-Quat4f slerp(Quat4f const &q0, Quat4f const &q1, float t);
-Vec3f rotateAround(Vec3f const &vec, Vec3f const &axis, float radians);
-void rotateAround(Vec3f &vec, Vec3f const &axis, float radians);
+  Vec3<T> n(axis);
+  n.normalize();
 
-inline Quat4f::Quat4f(float re, float iV, float jV, float kV)
+  Quat<T> qAxis(cosAngle, n * sinAngle);
+
+  Vec3<T> rotated = qAxis * vec;
+  return rotated;
+}
+
+template <typename T>
+void rotateAround(Vec3<T> &vec, Vec3<T> const &axis,
+                  typename Vec3<T>::value_type radians) {
+  radians *= 0.5;
+  const T sinAngle = std::sin(radians);
+  const T cosAngle = std::cos(radians);
+
+  Vec3<T> n(axis);
+  n.normalize();
+
+  Quat<T> qAxis(cosAngle, n * sinAngle);
+
+  vec = qAxis * vec;
+}
+
+template <typename T>
+constexpr Quat<T>::Quat(T re, T iV, T jV, T kV)
     : m_re(re), m_im(iV, jV, kV) {}
 
-inline Quat4f::Quat4f(float re, Vec3f const &im) : m_re(re), m_im(im) {}
+template <typename T>
+constexpr Quat<T>::Quat(T re, Vec3<T> const &im) : m_re(re), m_im(im) {}
 
-inline Quat4f::Quat4f(Vec3f const &im) : m_re(0), m_im(im) {}
+template <typename T>
+constexpr Quat<T>::Quat(Vec3<T> const &im) : m_re(0), m_im(im) {}
 
-inline Quat4f const &Quat4f::operator=(float real) {
+template <typename T> inline Quat<T> const &Quat<T>::operator=(T real) {
   m_re = real;
-  m_im = Vec3f();
+  m_im = Vec3<T>();
   return *this;
 }
 
-inline Quat4f const &Quat4f::operator=(Vec3f const &imag) {
-  m_re = 0.0f;
+template <typename T>
+inline Quat<T> const &Quat<T>::operator=(Vec3<T> const &imag) {
+  m_re = T(0);
   m_im = imag;
   return *this;
 }
 
-inline float &Quat4f::operator[](int index) { return (&m_re)[index]; }
+template <typename T> inline T &Quat<T>::operator[](int index) {
+  return (&m_re)[index];
+}
 
-inline float const &Quat4f::operator[](int index) const {
+template <typename T> inline T const &Quat<T>::operator[](int index) const {
   return (&m_re)[index];
 }
 
-inline float &Quat4f::re() { return m_re; }
+template <typename T> inline T &Quat<T>::re() { return m_re; }
 
-inline float const &Quat4f::re() const { return m_re; }
+template <typename T> constexpr T const &Quat<T>::re() const { return m_re; }
 
-inline Vec3f &Quat4f::im() { return m_im; }
+template <typename T> inline Vec3<T> &Quat<T>::im() { return m_im; }
 
-inline Vec3f const &Quat4f::im() const { return m_im; }
+template <typename T> constexpr Vec3<T> const &Quat<T>::im() const {
+  return m_im;
+}
 
-inline Quat4f Quat4f::operator+(Quat4f const &rhs) const {
-  return Quat4f(m_re + rhs.m_re, m_im + rhs.m_im);
+template <typename T>
+constexpr Quat<T> Quat<T>::operator+(Quat const &rhs) const {
+  return Quat(m_re + rhs.m_re, m_im + rhs.m_im);
 }
 
-inline Quat4f Quat4f::operator-(Quat4f const &rhs) const {
-  return Quat4f(m_re - rhs.m_re, m_im - rhs.m_im);
+template <typename T>
+constexpr Quat<T> Quat<T>::operator-(Quat const &rhs) const {
+  return Quat(m_re - rhs.m_re, m_im - rhs.m_im);
 }
 
-inline Quat4f Quat4f::operator-() const { return Quat4f(-m_re, -m_im); }
+template <typename T> constexpr Quat<T> Quat<T>::operator-() const {
+  return Quat(-m_re, -m_im);
+}
 
-inline Quat4f Quat4f::operator*(float scalar) const {
-  return Quat4f(scalar * m_re, scalar * m_im);
+template <typename T> constexpr Quat<T> Quat<T>::operator*(T scalar) const {
+  return Quat(scalar * m_re, scalar * m_im);
 }
 
-inline Quat4f Quat4f::operator/(float scalar) const {
-  return Quat4f(m_re / scalar, m_im / scalar);
+template <typename T> constexpr Quat<T> Quat<T>::operator/(T scalar) const {
+  return Quat(m_re / scalar, m_im / scalar);
 }
 
-inline void Quat4f::operator+=(Quat4f const &rhs) {
+template <typename T> inline void Quat<T>::operator+=(Quat const &rhs) {
   m_re += rhs.m_re;
   m_im += rhs.m_im;
 }
 
-inline void Quat4f::operator+=(float scalar) { m_re += scalar; }
+template <typename T> inline void Quat<T>::operator+=(T scalar) {
+  m_re += scalar;
+}
 
-inline void Quat4f::operator-=(Quat4f const &rhs) {
+template <typename T> inline void Quat<T>::operator-=(Quat const &rhs) {
   m_re -= rhs.m_re;
   m_im -= rhs.m_im;
 }
 
-inline void Quat4f::operator-=(float scalar) { m_re -= scalar; }
+template <typename T> inline void Quat<T>::operator-=(T scalar) {
+  m_re -= scalar;
+}
 
-inline void Quat4f::operator*=(float scalar) {
+template <typename T> inline void Quat<T>::operator*=(T scalar) {
   m_re *= scalar;
   m_im *= scalar;
 }
 
-inline void Quat4f::operator/=(float scalar) {
+template <typename T> inline void Quat<T>::operator/=(T scalar) {
   m_re /= scalar;
   m_im /= scalar;
 }
 
-inline Quat4f Quat4f::operator*(Quat4f const &q) const {
+template <typename T>
+inline Quat<T> Quat<T>::operator*(Quat const &q) const {
   double const &s1(m_re);
   double const &s2(q.m_re);
-  Vec3f const &v1(m_im);
-  Vec3f const &v2(q.m_im);
+  Vec3<T> const &v1(m_im);
+  Vec3<T> const &v2(q.m_im);
 
-  return Quat4f(s1 * s2 - v1 * v2, s1 * v2 + s2 * v1 + (v1 ^ v2));
+  return Quat(s1 * s2 - v1 * v2, s1 * v2 + s2 * v1 + (v1 ^ v2));
 }
 
-inline Vec3f Quat4f::operator*(Vec3f const &v) const {
-  Quat4f qV(v);
+template <typename T>
+inline Vec3<T> Quat<T>::operator*(Vec3<T> const &v) const {
+  Quat qV(v);
 
-  Quat4f result = qV * ~(*this);
+  Quat result = qV * ~(*this);
   result = (*this) * result;
 
   return result.im();
 }
 
-inline Mat4f Quat4f::matrix4f() const {
-  float x = m_im.x();
-  float y = m_im.y();
-  float z = m_im.z();
-  float w = m_re;
+template <typename T> inline Mat4f Quat<T>::matrix4f() const {
+  T x = m_im.x();
+  T y = m_im.y();
+  T z = m_im.z();
+  T w = m_re;
 
-  float wx = w * x;
-  float wy = w * y;
-  float wz = w * z;
+  T wx = w * x;
+  T wy = w * y;
+  T wz = w * z;
 
-  float xx = x * x;
-  float xy = x * y;
-  float xz = x * z;
+  T xx = x * x;
+  T xy = x * y;
+  T xz = x * z;
 
-  float yy = y * y;
-  float yz = y * z;
+  T yy = y * y;
+  T yz = y * z;
 
-  float zz = z * z;
+  T zz = z * z;
 
-  Mat4f result = {1.f - 2.f * (yy + zz), 2.f * (xy - wz), 2.f * (xz + wy), 0,
-                  2.f * (xy + wz), 1.f - 2.f * (xx + zz), 2.f * (yz - wx), 0,
-                  2.f * (xz - wy), 2.f * (yz + wx), 1.f - 2.f * (xx + yy), 0,
-                  0, 0, 0, 1};
+  T one = 1;
+  T two = 2;
+  Mat4f result(one - two * (yy + zz), two * (xy - wz), two * (xz + wy), 0,
+               two * (xy + wz), one - two * (xx + zz), two * (yz - wx), 0,
+               two * (xz - wy), two * (yz + wx), one - two * (xx + yy), 0,
+               0, 0, 0, 1);
 
   return result;
 }
 
-inline void Quat4f::operator*=(Quat4f const &q) { *this = (*this * q); }
-
-inline float Quat4f::norm() const { return std::sqrt(normSquared()); }
+template <typename T> inline void Quat<T>::operator*=(Quat const &q) {
+  *this = (*this * q);
+}
 
-inline float Quat4f::normSquared() const { return m_re * m_re + m_im * m_im; }
+template <typename T> inline T Quat<T>::norm() const {
+  return std::sqrt(normSquared());
+}
 
-inline Quat4f Quat4f::normalized() const { return *this / norm(); }
+template <typename T> constexpr T Quat<T>::normSquared() const {
+  return m_re * m_re + m_im * m_im;
+}
 
-inline void Quat4f::normalize() { *this /= norm(); }
+template <typename T> inline Quat<T> Quat<T>::normalized() const {
+  return *this / norm();
+}
 
-inline Quat4f Quat4f::operator~() const { return Quat4f(m_re, -m_im); }
+template <typename T> inline void Quat<T>::normalize() { *this /= norm(); }
 
-inline Quat4f Quat4f::inv() const { return (~(*this)) / this->normSquared(); }
+template <typename T> constexpr Quat<T> Quat<T>::operator~() const {
+  return Quat(m_re, -m_im);
+}
 
-inline Quat4f operator*(float scalar, Quat4f const &q) { return q * scalar; }
+template <typename T> inline Quat<T> Quat<T>::inv() const {
+  return (~(*this)) / this->normSquared();
+}
 
 #endif // QUAT4F_H
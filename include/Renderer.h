@@ -0,0 +1,72 @@
+/**
+ * File:	Renderer.h
+ *
+ * Summary:
+ *
+ * The GL state the window's draws share. Program and vertex array binds go
+ * through useProgram() and bindVertexArray(), which skip the call when the
+ * object is already bound. The transform and the two flock colours live in
+ * one uniform buffer, the Frame block every program reads, so a camera
+ * move is a single buffer update whatever the number of programs.
+ *
+ * Programs resolve their own uniform locations once after linking, see
+ * attach(). Needs a current GL context from create() to destroy().
+ */
+
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include "glad/glad.h"
+
+#include "Mat4f.h"
+#include "Vec3f.h"
+
+class Renderer {
+public:
+  // uniform buffer binding point of the Frame block
+  enum { FRAME_BINDING = 0 };
+
+public:
+  Renderer();
+
+  void create();
+  void destroy();
+
+  // Connects the program's Frame block, if it has one, to the shared buffer
+  void attach(GLuint program);
+
+  void useProgram(GLuint program);
+  void bindVertexArray(GLuint vao);
+  // Forget what is bound, after GL was used behind the renderer's back
+  void invalidate();
+
+  // Upload only when the value changed
+  void setMVP(Mat4f const &mvp);
+  void setColors(Vec3f const &glyph, Vec3f const &heading);
+
+  unsigned skippedBinds() const; // binds avoided since create()
+
+private:
+  // std140 layout of the Frame block, see the shaders
+  struct Frame {
+    float mvp[16]; // row major
+    float glyphColor[4];
+    float headingColor[4];
+  };
+
+  void upload(GLintptr offset, GLsizeiptr size, void const *data);
+
+private:
+  GLuint m_frameBuffer;
+  Frame m_frame;
+
+  GLuint m_program;
+  GLuint m_vao;
+  unsigned m_skippedBinds;
+};
+
+// INLINE DEFINITIONS //
+
+inline unsigned Renderer::skippedBinds() const { return m_skippedBinds; }
+
+#endif // RENDERER_H
@@ -0,0 +1,270 @@
+/**
+ * File:	Simulation.h
+ *
+ * Summary:
+ *
+ * The flocking simulation on its own: the flock, the walls and the step
+ * that moves them. Nothing here touches GLFW or GL, the window in main.cpp
+ * and the boids_headless binary both drive a Simulation.
+ */
+
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <ostream>
+#include <vector>
+
+#include "BoidSystem.h"
+#include "DirtyRanges.h"
+#include "FlockStats.h"
+#include "MortonOrder.h"
+#include "NeighbourLists.h"
+#include "Obstacles.h"
+#include "Octree.h"
+#include "SpatialGrid.h"
+#include "ThreadPool.h"
+#include "Vec3f.h"
+
+// The values read from parameters.txt, besides the boid counts
+struct SimulationParams {
+  int fov;    // field of view, degrees
+  int border; // boids past +-border are turned back
+  int fol;    // radius for following
+
+  SimulationParams() : fov(270), border(300), fol(80) {}
+};
+
+class Simulation {
+public:
+  // the wall is a row of posts this far apart
+  static float const WALL_SPACING;
+
+  // How step() finds the boids near each boid: the uniform grid, the
+  // octree for flocks packed into a few dense clusters, or every boid, to
+  // compare against
+  enum NeighbourSearch {
+    SEARCH_GRID,
+    SEARCH_OCTREE,
+    SEARCH_BRUTE,
+    SEARCH_METHODS
+  };
+
+  static char const *neighbourSearchName(NeighbourSearch search);
+
+  // skin setVerletSkin() is usually given, about ten steps of prey travel
+  static float const DEFAULT_VERLET_SKIN;
+
+  // steps between Morton re-sorts unless setMortonInterval() says
+  // otherwise
+  enum { DEFAULT_MORTON_INTERVAL = 64 };
+
+public:
+  explicit Simulation(unsigned numThreads = ThreadPool::defaultThreads());
+
+  SimulationParams &params();
+  SimulationParams const &params() const;
+
+  // Replaces the flock with numBoids prey and numPreds predators, placed
+  // with rand(), and puts up the wall. Call srand() first to pick a seed.
+  void setup(unsigned numBoids, unsigned numPreds);
+
+  // Moves every boid once
+  void step();
+
+  // Candidate pairs the next step's flocking pass will test, what the
+  // neighbour search returns before any distance test. Builds the grid or
+  // octree for the current state, which the step would build anyway.
+  unsigned long long candidatePairs();
+
+  // Mouse following, every boid is drawn towards the target when on
+  bool followsTarget() const;
+  void setFollowTarget(bool follow);
+  void setTarget(Vec3f const &target);
+
+  NeighbourSearch neighbourSearch() const;
+  void setNeighbourSearch(NeighbourSearch search);
+
+  // The grid search moves only the boids that changed cell since the last
+  // step instead of building the grid anew, see SpatialGrid::update().
+  // On by default, the grid is the same either way.
+  bool incrementalGrid() const;
+  void setIncrementalGrid(bool incremental);
+
+  // Verlet lists on top of the search, see NeighbourLists. The search
+  // above only builds them, a step walks each prey's list instead. 0
+  // turns them off, the default.
+  float verletSkin() const;
+  void setVerletSkin(float skin);
+  NeighbourLists const &neighbourLists() const;
+
+  // Every this many steps, starting with the first after setup(), the
+  // boids are permuted into Morton order so that neighbours in space are
+  // neighbours in memory, see MortonOrder. Boid indices change then, ids
+  // don't. 0 keeps the order boids were created in.
+  unsigned mortonInterval() const;
+  void setMortonInterval(unsigned steps);
+  unsigned long long mortonSorts() const;
+
+  // Boids moved through boids() between steps are where the search's index
+  // last saw them until boidsMoved() is called, which the next step needs
+  // to find their neighbours, and should be added to changed()
+  BoidSystem &boids();
+  BoidSystem const &boids() const;
+  Obstacles const &obstacles() const;
+  ThreadPool &pool();
+
+  // Drops the index over the old positions, the next step or
+  // candidatePairs() builds one over the new ones
+  void boidsMoved();
+
+  // Aggregates of the state the last step started from
+  FlockStats const &stats() const;
+
+  // The grid over the boids as they are now, built at the end of every
+  // step. nullptr when another search is used, or the flock was replaced
+  // or boidsMoved() since.
+  SpatialGrid const *grid() const;
+
+  // The boids whose front state was written since the caller last cleared
+  // it, so a viewer can upload only those. Every step moves every boid,
+  // setup() and scalingReport() replace the flock.
+  DirtyRanges &changed();
+
+  // Times the step at 1, 2, 4 ... threads up to every core, on a copy of
+  // the current flock, and prints the speedup over one thread.
+  void scalingReport(std::ostream &out);
+
+private:
+  void boundaries(Vec3f p, Vec3f &velocity) const;
+  float reach() const;
+  void sortByMorton();
+
+  // the current search's index over the current positions
+  void buildIndex(float reach);
+  // fn(indices, count) for runs of boids holding every boid within radius
+  // of p, from the current search's index
+  template <typename Fn>
+  void forEachCandidate(Vec3f const &p, float radius, Fn fn) const;
+  // the same for boid i at p and the radius the index was built for,
+  // which the octree answers from i's leaf
+  template <typename Fn>
+  void forEachCandidateOf(unsigned i, Vec3f const &p, float radius,
+                          Fn fn) const;
+
+private:
+  SimulationParams m_params;
+  BoidSystem m_boids;
+  Obstacles m_obstacles;
+  FlockStats m_stats;
+
+  bool m_followTarget;
+  Vec3f m_target;
+
+  NeighbourSearch m_search;
+  SpatialGrid m_grid;
+  bool m_incrementalGrid;
+  unsigned long m_gridLayout; // boids.layout() the grid last saw, ~0ul for none
+  Octree m_octree;
+  bool m_indexCurrent; // m_search's index was built from the current positions
+  float m_indexReach;  // and for this reach, the octree's runs hold only it
+  std::vector<unsigned> m_allBoids; // 0..n-1, the brute force candidates
+
+  float m_verletSkin;
+  NeighbourLists m_lists;
+
+  unsigned m_mortonInterval;
+  unsigned m_stepsSinceSort; // ~0u until the first sort after setup()
+  unsigned long long m_mortonSorts;
+  MortonOrder m_morton;
+
+  DirtyRanges m_changed;
+
+  // Predator avoidance pushed onto each boid this step, and which boids got
+  // any, so only those need resetting afterwards
+  std::vector<Vec3f> m_scare;
+  std::vector<unsigned> m_scared;
+
+  ThreadPool m_pool;
+};
+
+// INLINE DEFINITIONS //
+
+inline SimulationParams &Simulation::params() { return m_params; }
+
+inline SimulationParams const &Simulation::params() const {
+  return m_params;
+}
+
+inline bool Simulation::followsTarget() const { return m_followTarget; }
+inline void Simulation::setFollowTarget(bool follow) {
+  m_followTarget = follow;
+}
+inline void Simulation::setTarget(Vec3f const &target) { m_target = target; }
+
+inline Simulation::NeighbourSearch Simulation::neighbourSearch() const {
+  return m_search;
+}
+
+inline void Simulation::setNeighbourSearch(NeighbourSearch search) {
+  if (search != m_search)
+    m_indexCurrent = false;
+  m_search = search;
+}
+
+inline bool Simulation::incrementalGrid() const { return m_incrementalGrid; }
+inline void Simulation::setIncrementalGrid(bool incremental) {
+  m_incrementalGrid = incremental;
+}
+
+inline float Simulation::verletSkin() const { return m_verletSkin; }
+inline void Simulation::setVerletSkin(float skin) { m_verletSkin = skin; }
+inline NeighbourLists const &Simulation::neighbourLists() const {
+  return m_lists;
+}
+
+inline unsigned Simulation::mortonInterval() const { return m_mortonInterval; }
+inline void Simulation::setMortonInterval(unsigned steps) {
+  m_mortonInterval = steps;
+}
+inline unsigned long long Simulation::mortonSorts() const {
+  return m_mortonSorts;
+}
+
+inline BoidSystem &Simulation::boids() { return m_boids; }
+inline BoidSystem const &Simulation::boids() const { return m_boids; }
+inline Obstacles const &Simulation::obstacles() const { return m_obstacles; }
+inline ThreadPool &Simulation::pool() { return m_pool; }
+inline void Simulation::boidsMoved() { m_indexCurrent = false; }
+inline FlockStats const &Simulation::stats() const { return m_stats; }
+inline DirtyRanges &Simulation::changed() { return m_changed; }
+
+inline SpatialGrid const *Simulation::grid() const {
+  return m_search == SEARCH_GRID && m_indexCurrent ? &m_grid : nullptr;
+}
+
+template <typename Fn>
+void Simulation::forEachCandidate(Vec3f const &p, float radius,
+                                  Fn fn) const {
+  switch (m_search) {
+  case SEARCH_GRID:
+    m_grid.forEachSpan(p, radius, fn);
+    break;
+  case SEARCH_OCTREE:
+    m_octree.forEachSpan(p, radius, fn);
+    break;
+  default:
+    fn(m_allBoids.data(), m_allBoids.size());
+    break;
+  }
+}
+
+template <typename Fn>
+void Simulation::forEachCandidateOf(unsigned i, Vec3f const &p, float radius,
+                                    Fn fn) const {
+  if (m_search == SEARCH_OCTREE)
+    m_octree.forEachSpanOf(i, fn);
+  else
+    forEachCandidate(p, radius, fn);
+}
+
+#endif // SIMULATION_H
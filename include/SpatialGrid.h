@@ -0,0 +1,300 @@
+/**
+ * File:	SpatialGrid.h
+ *
+ * Summary:
+ *
+ * Uniform grid over boid positions, fitted to the flock by build() and
+ * kept up to date between builds by update(), see below. Boids are
+ * bucketed by cell with a counting sort, so every cell is a
+ * contiguous run of indices in one array. A radius query then only visits
+ * the cells within reach of the query point instead of every boid.
+ *
+ * The build runs on a thread pool without locks: each boid takes its
+ * rank in its cell from an atomic per cell counter, a two level prefix
+ * sum turns the counts into cell starts, and each boid is written to its
+ * cell start plus rank. Cells are left in index order whatever order the
+ * threads got there in, so queries and the sums over them don't depend on
+ * the number of threads.
+ *
+ * Boids move a unit or so a step against cells of about 80, so from one
+ * step to the next few change cell. update() keeps the cells of the last
+ * build and only moves the boids that left theirs, merging them into the
+ * cells they entered. Boids that wander past the bounds of the build go
+ * in the edge cells, whose boxes grow to hold them.
+ */
+
+#ifndef SPATIAL_GRID_H
+#define SPATIAL_GRID_H
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cmath>
+
+#include "Vec3f.h"
+
+class ThreadPool;
+
+class SpatialGrid {
+public:
+  // Upper bound on cells per axis, keeps memory sane if boids scatter far
+  // outside the border. The cell size grows instead.
+  enum { MAX_DIM = 128 };
+
+  // update() rebuilds instead when more than one boid in this many
+  // changed cell, past that the merge costs about as much as a build
+  enum { REBUILD_FRACTION = 8 };
+  // or when more than one in this many is past the bounds of the build
+  enum { OUTSIDE_FRACTION = 64 };
+
+public:
+  SpatialGrid();
+
+  // cellSize should be the largest radius that will be queried, so that a
+  // query never has to look further than the neighbouring cells.
+  void build(float const *x, float const *y, float const *z, unsigned n,
+             float cellSize, ThreadPool &pool);
+
+  // The same boids, same indices, after they moved: moves the ones whose
+  // cell changed, the cells and their bounds staying as the last build
+  // made them. Builds instead if none was made for this n and cellSize,
+  // or too many boids changed cell or left the grid's bounds.
+  void update(float const *x, float const *y, float const *z, unsigned n,
+              float cellSize, ThreadPool &pool);
+
+  // Boids the last build() or update() put in a different cell, all of
+  // them for a build
+  unsigned migrated() const;
+  // Whether that was a build, asked for or fallen back to
+  bool rebuilt() const;
+
+  // Calls fn(j) for every boid j in the cells overlapping the cube of
+  // half-width radius around p. Callers still need to test the distance.
+  template <typename Fn>
+  void forEachNear(Vec3f const &p, float radius, Fn fn) const;
+
+  // Same cells as forEachNear, but calls fn(indices, count) once per run of
+  // x-adjacent cells, which are contiguous in the index array.
+  template <typename Fn>
+  void forEachSpan(Vec3f const &p, float radius, Fn fn) const;
+
+  // Calls fn(indices, count) for the boids of every cell whose box, grown
+  // by margin on each side, classify(lo, hi) does not put outside. classify
+  // returns < 0 for outside, 0 for partly inside, > 0 for all inside. Boxes
+  // of many cells are tested first and only split where partly inside, so
+  // the cost follows the visible surface, not the number of cells.
+  template <typename Classify, typename Fn>
+  void forEachSpanIn(Classify classify, float margin, Fn fn) const;
+
+  // The same cells, one at a time, for callers that need each cell's box:
+  // calls fn(lo, hi, indices, count) for every occupied cell that
+  // classify(lo, hi) does not put outside, lo..hi without the margin.
+  // Every boid of a cell lies within its box.
+  template <typename Classify, typename Fn>
+  void forEachCellIn(Classify classify, float margin, Fn fn) const;
+
+  float cellSize() const;
+  int numCells() const;
+
+private:
+  int cellCoord(float v, int axis) const;
+  int cellIndex(int cx, int cy, int cz) const;
+  // the box of the cells lo..hi inclusive, edge cells grown by how far
+  // the boids in them are past the bounds
+  void cellsBox(int const lo[3], int const hi[3], Vec3f &boxLo,
+                Vec3f &boxHi) const;
+
+  // the cells lo..hi inclusive, a run of x per row
+  template <typename Fn>
+  void forEachSpanInCells(int const lo[3], int const hi[3], Fn &fn) const;
+  // calls visit(lo, hi) for the blocks of cells lo..hi not outside
+  template <typename Classify, typename Visit>
+  void cullCells(int const lo[3], int const hi[3], Classify &classify,
+                 float margin, Visit &visit) const;
+
+private:
+  float m_cellSize;
+  Vec3f m_min;
+  int m_dim[3];
+  // how far boids update() left in the edge cells are below m_min and
+  // above m_min + m_dim * m_cellSize, 0 after a build
+  Vec3f m_overLo, m_overHi;
+
+  std::vector<unsigned> m_cellStart; // numCells + 1 offsets into m_indices
+  std::vector<unsigned> m_indices;   // boid indices, sorted by cell
+
+  float m_builtCellSize; // what the last build was asked for, 0 for none
+  unsigned m_migrated;
+  bool m_rebuilt;
+
+  // scratch for update: the boids that changed cell per chunk, then all
+  // of them by the cell entered and by the cell left, and the cells and
+  // indices being merged
+  struct Move {
+    unsigned boid, from, to;
+  };
+  std::vector<std::vector<Move>> m_chunkMoves;
+  std::vector<Move> m_arrivals;
+  std::vector<Move> m_departures;
+  std::vector<unsigned> m_newCellStart;
+  std::vector<unsigned char> m_touched; // cells a boid left or entered
+  std::vector<unsigned> m_newIndices;
+
+  // scratch for build: cell and rank in it of each boid, the per cell
+  // counters, the per block sums of the prefix sum. The cells are kept
+  // for update to compare against.
+  std::vector<unsigned> m_cellOf;
+  std::vector<unsigned> m_rank;
+  std::unique_ptr<std::atomic<unsigned>[]> m_count;
+  unsigned m_countSize;
+  std::vector<unsigned> m_blockSum;
+};
+
+// INLINE DEFINITIONS //
+
+inline float SpatialGrid::cellSize() const { return m_cellSize; }
+inline unsigned SpatialGrid::migrated() const { return m_migrated; }
+inline bool SpatialGrid::rebuilt() const { return m_rebuilt; }
+
+inline int SpatialGrid::numCells() const {
+  return m_dim[0] * m_dim[1] * m_dim[2];
+}
+
+inline int SpatialGrid::cellCoord(float v, int axis) const {
+  int c = int(std::floor((v - m_min[axis]) / m_cellSize));
+  if (c < 0)
+    return 0;
+  if (c >= m_dim[axis])
+    return m_dim[axis] - 1;
+  return c;
+}
+
+inline int SpatialGrid::cellIndex(int cx, int cy, int cz) const {
+  return (cz * m_dim[1] + cy) * m_dim[0] + cx;
+}
+
+inline void SpatialGrid::cellsBox(int const lo[3], int const hi[3],
+                                  Vec3f &boxLo, Vec3f &boxHi) const {
+  for (int a = 0; a < 3; a++) {
+    boxLo[a] = m_min[a] + lo[a] * m_cellSize;
+    boxHi[a] = m_min[a] + (hi[a] + 1) * m_cellSize;
+    if (lo[a] == 0)
+      boxLo[a] -= m_overLo[a];
+    if (hi[a] == m_dim[a] - 1)
+      boxHi[a] += m_overHi[a];
+  }
+}
+
+template <typename Fn>
+void SpatialGrid::forEachSpan(Vec3f const &p, float radius, Fn fn) const {
+  if (m_indices.empty())
+    return;
+
+  int lo[3], hi[3];
+  for (int a = 0; a < 3; a++) {
+    lo[a] = cellCoord(p[a] - radius, a);
+    hi[a] = cellCoord(p[a] + radius, a);
+  }
+
+  forEachSpanInCells(lo, hi, fn);
+}
+
+template <typename Fn>
+void SpatialGrid::forEachNear(Vec3f const &p, float radius, Fn fn) const {
+  forEachSpan(p, radius, [&](unsigned const *indices, unsigned count) {
+    for (unsigned k = 0; k < count; k++)
+      fn(indices[k]);
+  });
+}
+
+template <typename Fn>
+void SpatialGrid::forEachSpanInCells(int const lo[3], int const hi[3],
+                                     Fn &fn) const {
+  for (int cz = lo[2]; cz <= hi[2]; cz++) {
+    for (int cy = lo[1]; cy <= hi[1]; cy++) {
+      int row = cellIndex(0, cy, cz);
+      unsigned begin = m_cellStart[row + lo[0]];
+      unsigned end = m_cellStart[row + hi[0] + 1];
+      if (end > begin)
+        fn(&m_indices[begin], end - begin);
+    }
+  }
+}
+
+template <typename Classify, typename Visit>
+void SpatialGrid::cullCells(int const lo[3], int const hi[3],
+                            Classify &classify, float margin,
+                            Visit &visit) const {
+  Vec3f boxLo, boxHi;
+  cellsBox(lo, hi, boxLo, boxHi);
+  boxLo -= Vec3f(margin, margin, margin);
+  boxHi += Vec3f(margin, margin, margin);
+
+  int side = classify(boxLo, boxHi);
+  if (side < 0)
+    return;
+
+  // split the longest side in two, unless inside or down to one cell
+  int axis = 0;
+  for (int a = 1; a < 3; a++)
+    if (hi[a] - lo[a] > hi[axis] - lo[axis])
+      axis = a;
+
+  if (side > 0 || hi[axis] == lo[axis]) {
+    visit(lo, hi);
+    return;
+  }
+
+  int mid = (lo[axis] + hi[axis]) / 2;
+  int loHalfHi[3] = {hi[0], hi[1], hi[2]};
+  int hiHalfLo[3] = {lo[0], lo[1], lo[2]};
+  loHalfHi[axis] = mid;
+  hiHalfLo[axis] = mid + 1;
+  cullCells(lo, loHalfHi, classify, margin, visit);
+  cullCells(hiHalfLo, hi, classify, margin, visit);
+}
+
+template <typename Classify, typename Fn>
+void SpatialGrid::forEachSpanIn(Classify classify, float margin,
+                                Fn fn) const {
+  if (m_indices.empty())
+    return;
+
+  auto visit = [&](int const lo[3], int const hi[3]) {
+    forEachSpanInCells(lo, hi, fn);
+  };
+  int lo[3] = {0, 0, 0};
+  int hi[3] = {m_dim[0] - 1, m_dim[1] - 1, m_dim[2] - 1};
+  cullCells(lo, hi, classify, margin, visit);
+}
+
+template <typename Classify, typename Fn>
+void SpatialGrid::forEachCellIn(Classify classify, float margin,
+                                Fn fn) const {
+  if (m_indices.empty())
+    return;
+
+  auto visit = [&](int const lo[3], int const hi[3]) {
+    for (int cz = lo[2]; cz <= hi[2]; cz++) {
+      for (int cy = lo[1]; cy <= hi[1]; cy++) {
+        for (int cx = lo[0]; cx <= hi[0]; cx++) {
+          int cell = cellIndex(cx, cy, cz);
+          unsigned begin = m_cellStart[cell];
+          unsigned end = m_cellStart[cell + 1];
+          if (end == begin)
+            continue;
+
+          int const c[3] = {cx, cy, cz};
+          Vec3f cellLo, cellHi;
+          cellsBox(c, c, cellLo, cellHi);
+          fn(cellLo, cellHi, &m_indices[begin], end - begin);
+        }
+      }
+    }
+  };
+  int lo[3] = {0, 0, 0};
+  int hi[3] = {m_dim[0] - 1, m_dim[1] - 1, m_dim[2] - 1};
+  cullCells(lo, hi, classify, margin, visit);
+}
+
+#endif // SPATIAL_GRID_H
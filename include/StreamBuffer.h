@@ -0,0 +1,81 @@
+/**
+ * File:	StreamBuffer.h
+ *
+ * Summary:
+ *
+ * Vertex buffer for data rewritten every frame. The buffer is a ring of
+ * REGIONS equal regions. Each frame maps the next one with
+ * glMapBufferRange, unsynchronized and invalidating, so the driver never
+ * has to wait for draws still reading an older region, and the storage is
+ * only reallocated when a frame outgrows it. A fence placed after the
+ * draws guards each region. Coming back to a region whose fence has not
+ * signalled yet waits on it, and counts as a stall.
+ *
+ * If mapping fails, or BOIDS_STREAM=orphan is set, the buffer falls back
+ * to orphaning: glBufferData with no data every frame, then a write to the
+ * fresh storage at offset 0.
+ *
+ * Needs a current GL context from create() to destroy().
+ */
+
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include "glad/glad.h"
+
+class StreamBuffer {
+public:
+  // regions in the ring, one written while up to two are still drawn
+  enum { REGIONS = 3 };
+
+public:
+  StreamBuffer();
+  ~StreamBuffer();
+
+  StreamBuffer(StreamBuffer const &) = delete;
+  StreamBuffer &operator=(StreamBuffer const &) = delete;
+
+  void create();
+  void destroy();
+
+  // Maps size bytes for this frame's data, bound to GL_ARRAY_BUFFER.
+  // Returns nullptr, and nothing needs unmapping, if size is 0.
+  void *map(GLsizeiptr size);
+  // Unmaps, returns the byte offset of the data written since map()
+  GLintptr unmap();
+  // Call once the draws reading the last unmapped data have been issued
+  void fence();
+
+  GLuint id() const;
+  bool orphaning() const;
+
+  unsigned stalls() const;        // waits on a fence not yet signalled
+  unsigned reallocations() const; // ring grown, or storage orphaned
+
+private:
+  void *mapOrphan(GLsizeiptr size);
+  void waitFor(unsigned region);
+
+private:
+  GLuint m_id;
+  bool m_orphan;
+
+  GLsizeiptr m_regionSize;
+  unsigned m_region; // the region map() last handed out
+  GLsync m_fences[REGIONS];
+
+  unsigned m_stalls;
+  unsigned m_reallocations;
+};
+
+// INLINE DEFINITIONS //
+
+inline GLuint StreamBuffer::id() const { return m_id; }
+inline bool StreamBuffer::orphaning() const { return m_orphan; }
+inline unsigned StreamBuffer::stalls() const { return m_stalls; }
+
+inline unsigned StreamBuffer::reallocations() const {
+  return m_reallocations;
+}
+
+#endif // STREAM_BUFFER_H
@@ -0,0 +1,88 @@
+/**
+ * File:	ThreadPool.h
+ *
+ * Summary:
+ *
+ * Persistent pool of worker threads for data parallel loops. The threads are
+ * created once and sleep between jobs, so running a parallelFor every frame
+ * costs a wake up, not a thread creation. The calling thread takes chunks
+ * too, a pool of size 1 has no workers and runs everything inline.
+ *
+ * Jobs do not nest, fn must not call parallelFor on the same pool.
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+  // BOIDS_THREADS if set, else every hardware thread
+  static unsigned defaultThreads();
+
+public:
+  explicit ThreadPool(unsigned numThreads = defaultThreads());
+  ~ThreadPool();
+
+  ThreadPool(ThreadPool const &) = delete;
+  ThreadPool &operator=(ThreadPool const &) = delete;
+
+  // Threads taking part in a parallelFor, the caller included
+  unsigned size() const;
+  void resize(unsigned numThreads);
+
+  // Calls fn(begin, end) over [0, count) in chunks of about grain items and
+  // returns when all of them are done.
+  template <typename Fn>
+  void parallelFor(unsigned count, unsigned grain, Fn const &fn);
+
+private:
+  typedef void (*Task)(void const *fn, unsigned begin, unsigned end);
+
+  template <typename Fn>
+  static void call(void const *fn, unsigned begin, unsigned end);
+
+  void run(unsigned count, unsigned grain, Task task, void const *fn);
+  void work();
+  void workerLoop();
+  void start(unsigned numWorkers);
+  void stop();
+
+private:
+  std::vector<std::thread> m_workers;
+
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  std::condition_variable m_done;
+  unsigned long m_generation;
+  unsigned m_busy;
+  bool m_quit;
+
+  // the job being run, written under m_mutex before waking the workers
+  Task m_task;
+  void const *m_fn;
+  unsigned m_count;
+  unsigned m_grain;
+  std::atomic<unsigned> m_next;
+};
+
+// INLINE DEFINITIONS //
+
+inline unsigned ThreadPool::size() const { return m_workers.size() + 1; }
+
+template <typename Fn>
+void ThreadPool::call(void const *fn, unsigned begin, unsigned end) {
+  (*static_cast<Fn const *>(fn))(begin, end);
+}
+
+template <typename Fn>
+void ThreadPool::parallelFor(unsigned count, unsigned grain, Fn const &fn) {
+  run(count, grain, &ThreadPool::call<Fn>, &fn);
+}
+
+#endif // THREAD_POOL_H
@@ -8,6 +8,13 @@
  * Copyright (c) 2017 - Please give credit to the author.
  *
  * File:	Vec3f.h
+ *
+ * Summary:
+ *
+ * Vec3<T>, a 3 component vector of any floating point type. Vec3f, the
+ * float one, is what the simulation and the renderer use, Vec3d is there
+ * to rerun float code in double and compare. Everything is inline, and
+ * what C++11 allows is constexpr.
  */
 
 #ifndef VEC3F_H
@@ -17,283 +24,325 @@
 #include <cmath>     // std::{sqrt, abs, etc.}
 #include <algorithm> // std::swap
 
-class Vec3f {
+template <typename T> class Vec3 {
 public:
-  static float distance(Vec3f const &a, Vec3f const &b);
+  typedef T value_type;
+
+  static T distance(Vec3 const &a, Vec3 const &b);
 
 public:
   //  no explicit ... danger danger
-  explicit Vec3f(float x = 0.f, float y = 0.f, float z = 0.f);
-  Vec3f(Vec3f const &other) = default;
+  constexpr explicit Vec3(T x = T(0), T y = T(0), T z = T(0));
+  Vec3(Vec3 const &other) = default;
+  Vec3 &operator=(Vec3 const &other) = default;
+
+  // from a vector of another precision
+  template <typename U> constexpr explicit Vec3(Vec3<U> const &other);
 
   // Getter/Setter
-  float x() const;
-  float &x();
-  void x(float x);
-  float y() const;
-  float &y();
-  void y(float y);
-  float z() const;
-  float &z();
-  void z(float z);
-
-  void set(float x, float y, float z);
+  constexpr T x() const;
+  T &x();
+  void x(T x);
+  constexpr T y() const;
+  T &y();
+  void y(T y);
+  constexpr T z() const;
+  T &z();
+  void z(T z);
+
+  void set(T x, T y, T z);
   void zero();
   bool hasNans() const;
   bool hasInfs() const;
 
-  float &operator[](int idx);
-  float operator[](int idx) const;
+  T &operator[](int idx);
+  constexpr T operator[](int idx) const;
 
   // Usefull Member Functions
-  static Vec3f abs(Vec3f const &);
-  Vec3f normalized() const;
+  Vec3 normalized() const;
   void normalize();
-  float length() const;
-  float lengthSquared() const;
-  float distance(Vec3f const &other) const;
-  float dotProduct(Vec3f const &other) const;
-  Vec3f crossProduct(Vec3f const &other) const;
-  Vec3f projectOnto(Vec3f const &other) const;
+  T length() const;
+  constexpr T lengthSquared() const;
+  T distance(Vec3 const &other) const;
+  constexpr T dotProduct(Vec3 const &other) const;
+  constexpr Vec3 crossProduct(Vec3 const &other) const;
+  Vec3 projectOnto(Vec3 const &other) const;
 
   // Usefull Member Operators
 
-  Vec3f operator^(const Vec3f &other) const; // cross product
-  float operator*(const Vec3f &other) const; // dot product
+  constexpr Vec3 operator^(const Vec3 &other) const; // cross product
+  constexpr T operator*(const Vec3 &other) const;    // dot product
 
-  Vec3f operator-() const;
-  Vec3f operator*(float factor) const;
-  Vec3f operator/(float factor) const;
-  Vec3f operator+(const Vec3f &other) const;
-  Vec3f operator-(const Vec3f &other) const;
-  Vec3f &operator=(Vec3f other); // assignment operator
-  void operator+=(const Vec3f &other);
-  void operator-=(const Vec3f &other);
-  void operator*=(float factor);
-  void operator/=(float factor);
+  constexpr Vec3 operator-() const;
+  constexpr Vec3 operator*(T factor) const;
+  constexpr Vec3 operator/(T factor) const;
+  constexpr Vec3 operator+(const Vec3 &other) const;
+  constexpr Vec3 operator-(const Vec3 &other) const;
+  void operator+=(const Vec3 &other);
+  void operator-=(const Vec3 &other);
+  void operator*=(T factor);
+  void operator/=(T factor);
 
-  bool operator==(Vec3f const &other) const;
+  constexpr bool operator==(Vec3 const &other) const;
 
-  Vec3f radRotateAboutZ(double radians) const;
-  Vec3f radRotateAboutY(double radians) const;
-  Vec3f radRotateAboutX(double radians) const;
+  Vec3 radRotateAboutZ(double radians) const;
+  Vec3 radRotateAboutY(double radians) const;
+  Vec3 radRotateAboutX(double radians) const;
 
-  Vec3f componentwiseMult(Vec3f const &rhs) const;
+  constexpr Vec3 componentwiseMult(Vec3 const &rhs) const;
 
-  float *data();
-  float const *data() const;
+  T *data();
+  T const *data() const;
 
-  friend Vec3f operator*(float scalar, Vec3f const &vec);
-  friend void swap(Vec3f &l, Vec3f &r);
+  // hidden friends, so the scalar converts like it does for a member
+  friend constexpr Vec3 operator*(T scalar, Vec3 const &vec) {
+    return vec * scalar;
+  }
+  friend void swap(Vec3 &l, Vec3 &r) {
+    std::swap(l.m_coord[0], r.m_coord[0]);
+    std::swap(l.m_coord[1], r.m_coord[1]);
+    std::swap(l.m_coord[2], r.m_coord[2]);
+  }
 
-  static Vec3f lerp(float t, Vec3f const &a, Vec3f const &b);
-  static Vec3f slerp(float t, Vec3f const &a, Vec3f const &b);
+  static constexpr Vec3 lerp(T t, Vec3 const &a, Vec3 const &b);
+  static Vec3 slerp(T t, Vec3 const &a, Vec3 const &b);
 
 private:
-  union {
-    struct {
-      float m_x, m_y, m_z;
-    };
-    float m_coord[3];
-  };
+  T m_coord[3];
 };
 
-std::ostream &operator<<(std::ostream &out, Vec3f const &vec);
-std::istream &operator>>(std::istream &in, Vec3f &vec);
+typedef Vec3<float> Vec3f;
+typedef Vec3<double> Vec3d;
+
+// INLINE DEFINITIONS //
 
-inline float Vec3f::distance(Vec3f const &a, Vec3f const &b) {
+template <typename T>
+std::ostream &operator<<(std::ostream &out, Vec3<T> const &vec) {
+  return out << vec.x() << " " << vec.y() << " " << vec.z();
+}
+
+template <typename T>
+std::istream &operator>>(std::istream &in, Vec3<T> &vec) {
+  return in >> vec.x() >> vec.y() >> vec.z();
+}
+
+template <typename T>
+inline T Vec3<T>::distance(Vec3 const &a, Vec3 const &b) {
   return a.distance(b);
 }
 
-inline Vec3f::Vec3f(float x, float y, float z) : m_x(x), m_y(y), m_z(z) {}
+template <typename T>
+constexpr Vec3<T>::Vec3(T x, T y, T z) : m_coord{x, y, z} {}
+
+template <typename T>
+template <typename U>
+constexpr Vec3<T>::Vec3(Vec3<U> const &other)
+    : m_coord{T(other.x()), T(other.y()), T(other.z())} {}
 
 // Functions
-inline Vec3f abs(const Vec3f &v) {
-  Vec3f out(std::abs(v.x()), std::abs(v.y()), std::abs(v.z()));
+template <typename T> inline Vec3<T> abs(const Vec3<T> &v) {
+  Vec3<T> out(std::abs(v.x()), std::abs(v.y()), std::abs(v.z()));
   return out;
 }
 
-inline bool Vec3f::operator==(Vec3f const &other) const {
-  return (m_x == other.m_x && m_y == other.m_y && m_z == other.m_z);
+template <typename T>
+constexpr bool Vec3<T>::operator==(Vec3 const &other) const {
+  return (x() == other.x() && y() == other.y() && z() == other.z());
 }
 
-inline float Vec3f::length() const {
-  return std::sqrt(m_x * m_x + m_y * m_y + m_z * m_z);
+template <typename T> inline T Vec3<T>::length() const {
+  return std::sqrt(lengthSquared());
 }
 
-inline float Vec3f::lengthSquared() const {
-  return m_x * m_x + m_y * m_y + m_z * m_z;
+template <typename T> constexpr T Vec3<T>::lengthSquared() const {
+  return x() * x() + y() * y() + z() * z();
 }
 
-inline float Vec3f::distance(Vec3f const &other) const {
-  Vec3f tmp = *this - other; // blah... ha.
+template <typename T> inline T Vec3<T>::distance(Vec3 const &other) const {
+  Vec3 tmp = *this - other; // blah... ha.
   return tmp.length();
 }
 
-inline float Vec3f::dotProduct(Vec3f const &other) const {
-  return m_x * other.x() + m_y * other.y() + m_z * other.z();
+template <typename T>
+constexpr T Vec3<T>::dotProduct(Vec3 const &other) const {
+  return x() * other.x() + y() * other.y() + z() * other.z();
 }
 
-inline Vec3f Vec3f::crossProduct(Vec3f const &other) const {
-  return Vec3f((m_y * other.m_z) - (m_z * other.m_y),
-               (m_z * other.m_x) - (m_x * other.m_z),
-               (m_x * other.m_y) - (m_y * other.m_x));
+template <typename T>
+constexpr Vec3<T> Vec3<T>::crossProduct(Vec3 const &other) const {
+  return Vec3((y() * other.z()) - (z() * other.y()),
+              (z() * other.x()) - (x() * other.z()),
+              (x() * other.y()) - (y() * other.x()));
 }
 
-inline Vec3f Vec3f::normalized() const {
-  Vec3f v(*this);
+template <typename T> inline Vec3<T> Vec3<T>::normalized() const {
+  Vec3 v(*this);
   v.normalize();
   return v;
 }
 
-inline void Vec3f::normalize() {
-  float len = length();
+template <typename T> inline void Vec3<T>::normalize() {
+  T len = length();
   // Check if zero?
-  m_x /= len;
-  m_y /= len;
-  m_z /= len;
+  m_coord[0] /= len;
+  m_coord[1] /= len;
+  m_coord[2] /= len;
 }
 
-inline Vec3f Vec3f::componentwiseMult(Vec3f const &rhs) const {
-  return Vec3f(m_x * rhs.m_x, m_y * rhs.m_y, m_z * rhs.m_z);
+template <typename T>
+constexpr Vec3<T> Vec3<T>::componentwiseMult(Vec3 const &rhs) const {
+  return Vec3(x() * rhs.x(), y() * rhs.y(), z() * rhs.z());
 }
 
-inline Vec3f Vec3f::projectOnto(Vec3f const &other) const {
-  float scaleRatio = dotProduct(other) / lengthSquared();
+template <typename T>
+inline Vec3<T> Vec3<T>::projectOnto(Vec3 const &other) const {
+  T scaleRatio = dotProduct(other) / lengthSquared();
   return other * scaleRatio;
 }
 
 // Operators
-inline float Vec3f::operator*(Vec3f const &other) const {
+template <typename T>
+constexpr T Vec3<T>::operator*(Vec3 const &other) const {
   return dotProduct(other);
 }
 
-inline Vec3f Vec3f::operator^(Vec3f const &other) const {
+template <typename T>
+constexpr Vec3<T> Vec3<T>::operator^(Vec3 const &other) const {
   return crossProduct(other);
 }
 
-inline Vec3f &Vec3f::operator=(Vec3f other) {
-  swap(other, *this);
-  return *this;
+template <typename T> constexpr Vec3<T> Vec3<T>::operator-() const {
+  return Vec3(-x(), -y(), -z());
 }
 
-inline Vec3f Vec3f::operator-() const {
-  Vec3f v(*this);
-  v *= -1.f;
-  return v;
+template <typename T>
+constexpr Vec3<T> Vec3<T>::operator+(Vec3 const &other) const {
+  return Vec3(x() + other.x(), y() + other.y(), z() + other.z());
 }
 
-inline Vec3f Vec3f::operator+(Vec3f const &other) const {
-  return Vec3f(m_x + other.x(), m_y + other.y(), m_z + other.z());
+template <typename T>
+constexpr Vec3<T> Vec3<T>::operator-(Vec3 const &other) const {
+  return Vec3(x() - other.x(), y() - other.y(), z() - other.z());
 }
 
-inline Vec3f Vec3f::operator-(Vec3f const &other) const {
-  return Vec3f(m_x - other.x(), m_y - other.y(), m_z - other.z());
+template <typename T> constexpr Vec3<T> Vec3<T>::operator*(T factor) const {
+  return Vec3(x() * factor, y() * factor, z() * factor);
 }
 
-inline Vec3f Vec3f::operator*(float factor) const {
-  return Vec3f(m_x * factor, m_y * factor, m_z * factor);
+template <typename T> constexpr Vec3<T> Vec3<T>::operator/(T factor) const {
+  return Vec3(x() / factor, y() / factor, z() / factor);
 }
 
-inline Vec3f Vec3f::operator/(float factor) const {
-  return Vec3f(m_x / factor, m_y / factor, m_z / factor);
+template <typename T> inline void Vec3<T>::operator+=(const Vec3 &other) {
+  m_coord[0] += other.m_coord[0];
+  m_coord[1] += other.m_coord[1];
+  m_coord[2] += other.m_coord[2];
 }
 
-inline Vec3f operator*(float factor, Vec3f const &vec) { return vec * factor; }
-
-inline void Vec3f::operator+=(const Vec3f &other) {
-  m_x += other.m_x;
-  m_y += other.m_y;
-  m_z += other.m_z;
+template <typename T> inline void Vec3<T>::operator-=(const Vec3 &other) {
+  m_coord[0] -= other.m_coord[0];
+  m_coord[1] -= other.m_coord[1];
+  m_coord[2] -= other.m_coord[2];
 }
 
-inline void Vec3f::operator-=(const Vec3f &other) {
-  m_x -= other.m_x;
-  m_y -= other.m_y;
-  m_z -= other.m_z;
+template <typename T> inline void Vec3<T>::operator*=(T factor) {
+  m_coord[0] *= factor;
+  m_coord[1] *= factor;
+  m_coord[2] *= factor;
 }
 
-inline void Vec3f::operator*=(float factor) {
-  m_x *= factor;
-  m_y *= factor;
-  m_z *= factor;
+template <typename T> inline void Vec3<T>::operator/=(T factor) {
+  m_coord[0] /= factor;
+  m_coord[1] /= factor;
+  m_coord[2] /= factor;
 }
 
-inline void Vec3f::operator/=(float factor) {
-  m_x /= factor;
-  m_y /= factor;
-  m_z /= factor;
-}
+template <typename T>
+inline Vec3<T> Vec3<T>::radRotateAboutX(double radians) const {
+  double s = std::sin(radians);
+  double c = std::cos(radians);
 
-inline void swap(Vec3f &l, Vec3f &r) {
-  std::swap(l.m_x, r.m_x);
-  std::swap(l.m_y, r.m_y);
-  std::swap(l.m_z, r.m_z);
+  return Vec3(x(), (y() * c) + (z() * -s), (y() * s) + (z() * c));
 }
 
-// Getter/Setter Junk
-inline float &Vec3f::operator[](int idx) { return m_coord[idx]; }
-
-inline float Vec3f::operator[](int idx) const { return m_coord[idx]; }
+template <typename T>
+inline Vec3<T> Vec3<T>::radRotateAboutY(double radians) const {
+  double s = std::sin(radians);
+  double c = std::cos(radians);
 
-inline void Vec3f::set(float x, float y, float z) {
-  m_x = x;
-  m_y = y;
-  m_z = z;
+  return Vec3((x() * c) + (z() * s), y(), (x() * -s) + (z() * c));
 }
 
-inline float Vec3f::x() const { return m_x; }
-
-inline float &Vec3f::x() { return m_x; }
-
-inline void Vec3f::x(float x) { m_x = x; }
+template <typename T>
+inline Vec3<T> Vec3<T>::radRotateAboutZ(double radians) const {
+  double s = std::sin(radians);
+  double c = std::cos(radians);
 
-inline float Vec3f::y() const { return m_y; }
+  return Vec3((x() * c) + (y() * -s), (x() * s) + (y() * c), z());
+}
 
-inline float &Vec3f::y() { return m_y; }
+// Getter/Setter Junk
+template <typename T> inline T &Vec3<T>::operator[](int idx) {
+  return m_coord[idx];
+}
 
-inline void Vec3f::y(float y) { m_y = y; }
+template <typename T> constexpr T Vec3<T>::operator[](int idx) const {
+  return m_coord[idx];
+}
 
-inline float Vec3f::z() const { return m_z; }
+template <typename T> inline void Vec3<T>::set(T x, T y, T z) {
+  m_coord[0] = x;
+  m_coord[1] = y;
+  m_coord[2] = z;
+}
 
-inline float &Vec3f::z() { return m_z; }
+template <typename T> constexpr T Vec3<T>::x() const { return m_coord[0]; }
+template <typename T> inline T &Vec3<T>::x() { return m_coord[0]; }
+template <typename T> inline void Vec3<T>::x(T x) { m_coord[0] = x; }
 
-inline void Vec3f::z(float z) { m_z = z; }
+template <typename T> constexpr T Vec3<T>::y() const { return m_coord[1]; }
+template <typename T> inline T &Vec3<T>::y() { return m_coord[1]; }
+template <typename T> inline void Vec3<T>::y(T y) { m_coord[1] = y; }
 
-inline float *Vec3f::data() { return &(m_coord[0]); }
+template <typename T> constexpr T Vec3<T>::z() const { return m_coord[2]; }
+template <typename T> inline T &Vec3<T>::z() { return m_coord[2]; }
+template <typename T> inline void Vec3<T>::z(T z) { m_coord[2] = z; }
 
-inline float const *Vec3f::data() const { return &(m_coord[0]); }
+template <typename T> inline T *Vec3<T>::data() { return m_coord; }
+template <typename T> inline T const *Vec3<T>::data() const { return m_coord; }
 
-inline void Vec3f::zero() {
-  m_x = 0.f;
-  m_y = 0.f;
-  m_z = 0.f;
+template <typename T> inline void Vec3<T>::zero() {
+  m_coord[0] = T(0);
+  m_coord[1] = T(0);
+  m_coord[2] = T(0);
 }
 
 // Static functions
-inline Vec3f Vec3f::lerp(float t, Vec3f const &a, Vec3f const &b) {
-  return (1.f - t) * a + t * b;
+template <typename T>
+constexpr Vec3<T> Vec3<T>::lerp(T t, Vec3 const &a, Vec3 const &b) {
+  return (T(1) - t) * a + t * b;
 }
 
-inline Vec3f Vec3f::slerp(float t, Vec3f const &a, Vec3f const &b) {
+template <typename T>
+inline Vec3<T> Vec3<T>::slerp(T t, Vec3 const &a, Vec3 const &b) {
   using std::acos;
   using std::sin;
 
   // TODO make more efficient
-  float omega = (a * b) / (a.length() * b.length());
+  T omega = (a * b) / (a.length() * b.length());
   omega = acos(omega);
-  float sinOmega = sin(omega);
+  T sinOmega = sin(omega);
 
   return (sin(omega - omega * t) / sinOmega) * a +
          (sin(omega * t) / sinOmega) * b;
 }
 
-inline bool Vec3f::hasNans() const {
-  return std::isnan(m_x) || std::isnan(m_y) || std::isnan(m_y);
+template <typename T> inline bool Vec3<T>::hasNans() const {
+  return std::isnan(x()) || std::isnan(y()) || std::isnan(z());
 }
 
-inline bool Vec3f::hasInfs() const {
-  return std::isinf(m_x) || std::isinf(m_y) || std::isinf(m_z);
+template <typename T> inline bool Vec3<T>::hasInfs() const {
+  return std::isinf(x()) || std::isinf(y()) || std::isinf(z());
 }
 
 #endif // Vec3f
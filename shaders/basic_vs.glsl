@@ -1,13 +1,19 @@
 #version 330
 layout( location = 0 ) in vec3 vert_modelSpace;
 
-uniform mat4 MVP;
-uniform vec3 inputColor;
+// Shared by every program, see Renderer.h
+layout( std140, row_major ) uniform Frame {
+	mat4 MVP;
+	vec4 glyphColor;
+	vec4 headingColor;
+};
+
+uniform bool drawHeading; // heading lines, else glyphs and walls
 
 out vec3 interpolateColor;
 
 void main()
 {
 	gl_Position = MVP * vec4( vert_modelSpace, 1.0 );
-	interpolateColor = inputColor;
+	interpolateColor = drawHeading ? headingColor.rgb : glyphColor.rgb;
 }
@@ -0,0 +1,66 @@
+#version 330
+// Expands a boid's point into its glyph, three triangles, and its heading
+// line, in one draw. A geometry shader emits a single primitive type, so
+// the line is a quad one pixel wide, turned to face the screen.
+layout( points ) in;
+layout( triangle_strip, max_vertices = 13 ) out;
+
+in vec3 boidHeading[];
+in float boidType[];
+
+// Shared by every program, see Renderer.h
+layout( std140, row_major ) uniform Frame {
+	mat4 MVP;
+	vec4 glyphColor;
+	vec4 headingColor;
+};
+
+uniform float headingLength;
+uniform vec2 viewport; // framebuffer size, pixels
+
+out vec3 interpolateColor;
+
+// the glyph at unit width, as the cpu path builds it
+const vec3 glyph[9] = vec3[9](
+	vec3( 0.5, 1.5, 0.0 ), vec3( 0.5, 0.5, 0.5 ), vec3( 0.0, 0.0, 0.0 ),
+	vec3( 0.0, 0.0, 0.0 ), vec3( 0.5, 0.5, 0.5 ), vec3( 1.0, 0.0, 0.0 ),
+	vec3( 1.0, 0.0, 0.0 ), vec3( 0.5, 0.5, 0.5 ), vec3( 0.5, 1.5, 0.0 ) );
+
+void main()
+{
+	vec3 position = gl_in[0].gl_Position.xyz;
+	float width = boidType[0] == 1.0 ? 7.0 : 2.0; // PREDATOR : PREY
+
+	for ( int t = 0; t < 3; t++ ) {
+		for ( int v = 0; v < 3; v++ ) {
+			gl_Position = MVP * vec4( position + glyph[3*t + v] * width, 1.0 );
+			interpolateColor = glyphColor.rgb;
+			EmitVertex();
+		}
+		EndPrimitive();
+	}
+
+	vec4 a = MVP * vec4( position, 1.0 );
+	vec4 b = MVP * vec4( position + boidHeading[0] * headingLength, 1.0 );
+	// behind the eye, the screen direction is meaningless
+	if ( a.w <= 0.0 || b.w <= 0.0 )
+		return;
+
+	vec2 along = ( b.xy / b.w - a.xy / a.w ) * viewport;
+	if ( dot( along, along ) == 0.0 )
+		return;
+
+	// half a pixel either side, in normalized device coordinates
+	vec2 side = normalize( vec2( -along.y, along.x ) ) / viewport;
+
+	interpolateColor = headingColor.rgb;
+	gl_Position = a + vec4( side * a.w, 0.0, 0.0 );
+	EmitVertex();
+	gl_Position = a - vec4( side * a.w, 0.0, 0.0 );
+	EmitVertex();
+	gl_Position = b + vec4( side * b.w, 0.0, 0.0 );
+	EmitVertex();
+	gl_Position = b - vec4( side * b.w, 0.0, 0.0 );
+	EmitVertex();
+	EndPrimitive();
+}
@@ -0,0 +1,20 @@
+#version 330
+// One point per boid, straight from the flock's arrays, the geometry
+// shader builds the glyph and heading line around it
+layout( location = 0 ) in float boid_x;
+layout( location = 1 ) in float boid_y;
+layout( location = 2 ) in float boid_z;
+layout( location = 3 ) in float boid_hx;
+layout( location = 4 ) in float boid_hy;
+layout( location = 5 ) in float boid_hz;
+layout( location = 6 ) in float boid_type; // BoidSystem::Type
+
+out vec3 boidHeading;
+out float boidType;
+
+void main()
+{
+	gl_Position = vec4( boid_x, boid_y, boid_z, 1.0 );
+	boidHeading = vec3( boid_hx, boid_hy, boid_hz );
+	boidType = boid_type;
+}
@@ -0,0 +1,41 @@
+#version 330
+// The glyph at unit width, or for the heading line (0,0,0) and (1,0,0)
+layout( location = 0 ) in vec3 vert_modelSpace;
+
+// One value per boid, straight from the flock's arrays
+layout( location = 1 ) in float boid_x;
+layout( location = 2 ) in float boid_y;
+layout( location = 3 ) in float boid_z;
+layout( location = 4 ) in float boid_hx;
+layout( location = 5 ) in float boid_hy;
+layout( location = 6 ) in float boid_hz;
+layout( location = 7 ) in float boid_type; // BoidSystem::Type
+
+// Shared by every program, see Renderer.h
+layout( std140, row_major ) uniform Frame {
+	mat4 MVP;
+	vec4 glyphColor;
+	vec4 headingColor;
+};
+
+uniform bool drawHeading;     // lines along the heading instead of glyphs
+uniform float headingLength;
+
+out vec3 interpolateColor;
+
+void main()
+{
+	vec3 position = vec3( boid_x, boid_y, boid_z );
+	vec3 world;
+
+	if ( drawHeading ) {
+		vec3 heading = vec3( boid_hx, boid_hy, boid_hz );
+		world = position + heading * headingLength * vert_modelSpace.x;
+	} else {
+		float width = boid_type == 1.0 ? 7.0 : 2.0; // PREDATOR : PREY
+		world = position + vert_modelSpace * width;
+	}
+
+	gl_Position = MVP * vec4( world, 1.0 );
+	interpolateColor = drawHeading ? headingColor.rgb : glyphColor.rgb;
+}
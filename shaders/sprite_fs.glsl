@@ -0,0 +1,14 @@
+#version 330 core
+// Round sprites, the corners of the point's square are dropped
+
+in vec3 interpolateColor;
+
+out vec3 color;
+
+void main()
+{
+	vec2 r = gl_PointCoord * 2.0 - 1.0;
+	if ( dot( r, r ) > 1.0 )
+		discard;
+	color = interpolateColor;
+}
@@ -0,0 +1,23 @@
+#version 330
+// Boids too far away for a glyph, and cells of them further still, as
+// points sized in world units, so they shrink with distance like the
+// glyphs they stand in for
+layout( location = 0 ) in vec4 sprite; // position, then world size
+
+// Shared by every program, see Renderer.h
+layout( std140, row_major ) uniform Frame {
+	mat4 MVP;
+	vec4 glyphColor;
+	vec4 headingColor;
+};
+
+uniform float pixelsPerUnit; // at distance 1, from the projection
+
+out vec3 interpolateColor;
+
+void main()
+{
+	gl_Position = MVP * vec4( sprite.xyz, 1.0 );
+	gl_PointSize = max( 1.0, sprite.w * pixelsPerUnit / gl_Position.w );
+	interpolateColor = glyphColor.rgb;
+}
@@ -0,0 +1,112 @@
+/**
+ * File:	BoidSystem.cpp
+ */
+
+#include "BoidSystem.h"
+
+#include "ThreadPool.h"
+
+// slots per task of permute()
+enum { PERMUTE_GRAIN = 4096 };
+
+void BoidSystem::clear() {
+  for (State &s : m_state) {
+    s.x.clear();
+    s.y.clear();
+    s.z.clear();
+    s.vx.clear();
+    s.vy.clear();
+    s.vz.clear();
+    s.hx.clear();
+    s.hy.clear();
+    s.hz.clear();
+  }
+  m_type.clear();
+  m_predators.clear();
+  m_id.clear();
+  m_slot.clear();
+  m_front = 0;
+  m_layout++;
+}
+
+void BoidSystem::reserve(unsigned n) {
+  for (State &s : m_state) {
+    s.x.reserve(n);
+    s.y.reserve(n);
+    s.z.reserve(n);
+    s.vx.reserve(n);
+    s.vy.reserve(n);
+    s.vz.reserve(n);
+    s.hx.reserve(n);
+    s.hy.reserve(n);
+    s.hz.reserve(n);
+  }
+  m_type.reserve(n);
+  m_id.reserve(n);
+  m_slot.reserve(n);
+}
+
+unsigned BoidSystem::add(Vec3f const &position, Vec3f const &velocity,
+                         Type type) {
+  // heading is the direction of travel, none if standing still
+  float speed = velocity.length();
+  Vec3f heading = speed > 0 ? velocity / speed : Vec3f(0, 0, 0);
+
+  // both buffers get the boid, the back one is overwritten by the next step
+  for (State &s : m_state) {
+    s.x.push_back(position.x());
+    s.y.push_back(position.y());
+    s.z.push_back(position.z());
+    s.vx.push_back(velocity.x());
+    s.vy.push_back(velocity.y());
+    s.vz.push_back(velocity.z());
+    s.hx.push_back(heading.x());
+    s.hy.push_back(heading.y());
+    s.hz.push_back(heading.z());
+  }
+  m_type.push_back(type);
+  m_id.push_back(m_slot.size());
+  m_slot.push_back(m_slot.size());
+  if (type == PREDATOR)
+    m_predators.push_back(size() - 1);
+
+  return size() - 1;
+}
+
+void BoidSystem::permute(std::vector<unsigned> const &order,
+                         ThreadPool &pool) {
+  unsigned n = size();
+  State const &from = front();
+  State &to = m_state[m_front ^ 1];
+  TypeArray types(n);
+  std::vector<unsigned> ids(n);
+
+  // gathered into the back state, which then becomes the front
+  pool.parallelFor(n, PERMUTE_GRAIN, [&](unsigned begin, unsigned end) {
+    for (unsigned k = begin; k < end; k++) {
+      unsigned i = order[k];
+      to.x[k] = from.x[i];
+      to.y[k] = from.y[i];
+      to.z[k] = from.z[i];
+      to.vx[k] = from.vx[i];
+      to.vy[k] = from.vy[i];
+      to.vz[k] = from.vz[i];
+      to.hx[k] = from.hx[i];
+      to.hy[k] = from.hy[i];
+      to.hz[k] = from.hz[i];
+      types[k] = m_type[i];
+      ids[k] = m_id[i];
+      m_slot[ids[k]] = k;
+    }
+  });
+  swap();
+  m_type.swap(types);
+  m_id.swap(ids);
+
+  m_predators.clear();
+  for (unsigned k = 0; k < n; k++)
+    if (m_type[k] == PREDATOR)
+      m_predators.push_back(k);
+
+  m_layout++;
+}
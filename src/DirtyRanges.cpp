@@ -0,0 +1,43 @@
+/**
+ * File:	DirtyRanges.cpp
+ */
+
+#include "DirtyRanges.h"
+
+#include <algorithm>
+
+void DirtyRanges::add(unsigned begin, unsigned end) {
+  if (begin >= end)
+    return;
+
+  // the ranges the new one overlaps or touches are folded into it
+  auto first = std::lower_bound(
+      m_ranges.begin(), m_ranges.end(), begin,
+      [](Range const &r, unsigned b) { return r.end < b; });
+  auto last = first;
+  while (last != m_ranges.end() && last->begin <= end) {
+    begin = std::min(begin, last->begin);
+    end = std::max(end, last->end);
+    ++last;
+  }
+  first = m_ranges.erase(first, last);
+  m_ranges.insert(first, Range{begin, end});
+
+  if (m_ranges.size() <= MAX_RANGES)
+    return;
+
+  unsigned closest = 0;
+  for (unsigned k = 1; k + 1 < m_ranges.size(); k++)
+    if (m_ranges[k + 1].begin - m_ranges[k].end <
+        m_ranges[closest + 1].begin - m_ranges[closest].end)
+      closest = k;
+  m_ranges[closest].end = m_ranges[closest + 1].end;
+  m_ranges.erase(m_ranges.begin() + closest + 1);
+}
+
+unsigned DirtyRanges::count() const {
+  unsigned n = 0;
+  for (Range const &r : m_ranges)
+    n += r.end - r.begin;
+  return n;
+}
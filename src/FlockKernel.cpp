@@ -0,0 +1,129 @@
+/**
+ * File:	FlockKernel.cpp
+ *
+ * Summary:
+ *
+ * Scalar flocking kernel, the reference the vector builds are checked
+ * against, and the cpuid based selection of which build to run.
+ */
+
+#include "FlockKernel.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+void flockKernelScalar(FlockSpan const &span, unsigned const *indices,
+                       unsigned count, FlockQuery const &q,
+                       FlockRules const &rules, FlockSums &sums) {
+  float const preyScale = 1.f / AVOID_PREY_DIV;
+
+  for (unsigned k = 0; k < count; k++) {
+    unsigned j = indices[k];
+    float dx = span.x[j] - q.px;
+    float dy = span.y[j] - q.py;
+    float dz = span.z[j] - q.pz;
+    float d = std::sqrt(dx * dx + dy * dy + dz * dz);
+
+    // in the view cone, the angle between heading and q - p is under phi.
+    // Comparing against cos(phi) * d skips normalising q - p, and rejects
+    // the boid itself since 0 > 0 fails.
+    bool seen = q.seeing && (q.hx * dx + q.hy * dy + q.hz * dz) >
+                                rules.cosHalfFov * d;
+
+    // only prey is flocked with, predators are scattered separately
+    if (!seen || span.type[j] != BoidSystem::PREY)
+      continue;
+
+    // if close enough, follow
+    if (d < rules.follow && d > rules.avoid) {
+      sums.count++;
+      sums.position[0] += span.x[j];
+      sums.position[1] += span.y[j];
+      sums.position[2] += span.z[j];
+      sums.velocity[0] += span.vx[j];
+      sums.velocity[1] += span.vy[j];
+      sums.velocity[2] += span.vz[j];
+    }
+    // avoid colliding into prey
+    if (d < rules.avoid) {
+      sums.avoid[0] -= dx * preyScale;
+      sums.avoid[1] -= dy * preyScale;
+      sums.avoid[2] -= dz * preyScale;
+    }
+  }
+}
+
+// ====== DISPATCH ==========================================================//
+
+static FlockKernelVariant s_variant = chooseFlockKernel();
+
+bool flockKernelSupported(FlockKernelVariant variant) {
+  switch (variant) {
+  case KERNEL_AVX2:
+    return __builtin_cpu_supports("avx2");
+  case KERNEL_SSE42:
+    return __builtin_cpu_supports("sse4.2");
+  default:
+    return true;
+  }
+}
+
+FlockKernelVariant chooseFlockKernel() {
+  __builtin_cpu_init();
+
+  FlockKernelVariant best = KERNEL_SCALAR;
+  if (flockKernelSupported(KERNEL_AVX2))
+    best = KERNEL_AVX2;
+  else if (flockKernelSupported(KERNEL_SSE42))
+    best = KERNEL_SSE42;
+
+  char const *forced = std::getenv("BOIDS_KERNEL");
+  if (!forced)
+    return best;
+
+  FlockKernelVariant variants[] = {KERNEL_SCALAR, KERNEL_SSE42, KERNEL_AVX2};
+  for (FlockKernelVariant v : variants) {
+    if (std::strcmp(forced, flockKernelName(v)) != 0)
+      continue;
+    if (flockKernelSupported(v))
+      return v;
+    std::cerr << "BOIDS_KERNEL=" << forced << " not supported by this cpu, "
+              << "using " << flockKernelName(best) << std::endl;
+    return best;
+  }
+
+  std::cerr << "Unknown BOIDS_KERNEL=" << forced << ", expected scalar, sse42"
+            << " or avx2" << std::endl;
+  return best;
+}
+
+FlockKernelVariant flockKernelVariant() { return s_variant; }
+
+void setFlockKernelVariant(FlockKernelVariant variant) {
+  if (flockKernelSupported(variant))
+    s_variant = variant;
+}
+
+FlockKernel flockKernel() {
+  switch (s_variant) {
+  case KERNEL_AVX2:
+    return flockKernelAVX2;
+  case KERNEL_SSE42:
+    return flockKernelSSE42;
+  default:
+    return flockKernelScalar;
+  }
+}
+
+char const *flockKernelName(FlockKernelVariant variant) {
+  switch (variant) {
+  case KERNEL_AVX2:
+    return "avx2";
+  case KERNEL_SSE42:
+    return "sse42";
+  default:
+    return "scalar";
+  }
+}
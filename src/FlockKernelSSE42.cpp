@@ -0,0 +1,146 @@
+/**
+ * File:	FlockKernelSSE42.cpp
+ *
+ * Summary:
+ *
+ * SSE4.2 build of the flocking kernel. Built with -msse4.2, only called
+ * when cpuid reports it. Candidates are taken 8 per iteration as two 4
+ * lane halves, with failed and out of range lanes masked out.
+ */
+
+#include "FlockKernel.h"
+
+#include <nmmintrin.h>
+
+namespace {
+
+struct Accum {
+  __m128 n;
+  __m128 sx, sy, sz;
+  __m128 svx, svy, svz;
+  __m128 ax, ay, az;
+};
+
+struct Consts {
+  __m128 px, py, pz;
+  __m128 hx, hy, hz;
+  __m128 seeing;
+  __m128 cosHalfFov, follow, avoid;
+  __m128 preyScale, one;
+  __m128i prey;
+};
+
+inline float horizontalSum(__m128 v) {
+  v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+  v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+  return _mm_cvtss_f32(v);
+}
+
+// one 4 lane half, idx and type already padded so every lane is loadable
+inline void lanes4(FlockSpan const &span, int const *idx, int const *type,
+                   Consts const &c, Accum &a) {
+  __m128 x = _mm_setr_ps(span.x[idx[0]], span.x[idx[1]], span.x[idx[2]],
+                         span.x[idx[3]]);
+  __m128 y = _mm_setr_ps(span.y[idx[0]], span.y[idx[1]], span.y[idx[2]],
+                         span.y[idx[3]]);
+  __m128 z = _mm_setr_ps(span.z[idx[0]], span.z[idx[1]], span.z[idx[2]],
+                         span.z[idx[3]]);
+  __m128i vt = _mm_load_si128((__m128i const *)type);
+
+  __m128 dx = _mm_sub_ps(x, c.px);
+  __m128 dy = _mm_sub_ps(y, c.py);
+  __m128 dz = _mm_sub_ps(z, c.pz);
+  __m128 d = _mm_sqrt_ps(
+      _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+                 _mm_mul_ps(dz, dz)));
+
+  __m128 dot =
+      _mm_add_ps(_mm_add_ps(_mm_mul_ps(c.hx, dx), _mm_mul_ps(c.hy, dy)),
+                 _mm_mul_ps(c.hz, dz));
+  __m128 seen =
+      _mm_and_ps(c.seeing, _mm_cmpgt_ps(dot, _mm_mul_ps(c.cosHalfFov, d)));
+
+  __m128 isPrey = _mm_castsi128_ps(_mm_cmpeq_epi32(vt, c.prey));
+
+  __m128 inAvoid = _mm_cmplt_ps(d, c.avoid);
+  __m128 seenPrey = _mm_and_ps(seen, isPrey);
+
+  // if close enough, follow
+  __m128 follows = _mm_and_ps(
+      seenPrey, _mm_and_ps(_mm_cmplt_ps(d, c.follow), _mm_cmpgt_ps(d, c.avoid)));
+  a.n = _mm_add_ps(a.n, _mm_and_ps(follows, c.one));
+  a.sx = _mm_add_ps(a.sx, _mm_and_ps(follows, x));
+  a.sy = _mm_add_ps(a.sy, _mm_and_ps(follows, y));
+  a.sz = _mm_add_ps(a.sz, _mm_and_ps(follows, z));
+  // velocities are only needed by followers, skip those loads when no
+  // lane follows
+  if (_mm_movemask_ps(follows)) {
+    __m128 vx = _mm_setr_ps(span.vx[idx[0]], span.vx[idx[1]],
+                            span.vx[idx[2]], span.vx[idx[3]]);
+    __m128 vy = _mm_setr_ps(span.vy[idx[0]], span.vy[idx[1]],
+                            span.vy[idx[2]], span.vy[idx[3]]);
+    __m128 vz = _mm_setr_ps(span.vz[idx[0]], span.vz[idx[1]],
+                            span.vz[idx[2]], span.vz[idx[3]]);
+    a.svx = _mm_add_ps(a.svx, _mm_and_ps(follows, vx));
+    a.svy = _mm_add_ps(a.svy, _mm_and_ps(follows, vy));
+    a.svz = _mm_add_ps(a.svz, _mm_and_ps(follows, vz));
+  }
+
+  // avoid colliding into prey, predators are scattered separately
+  __m128 scale = _mm_and_ps(_mm_and_ps(seenPrey, inAvoid), c.preyScale);
+
+  a.ax = _mm_sub_ps(a.ax, _mm_mul_ps(dx, scale));
+  a.ay = _mm_sub_ps(a.ay, _mm_mul_ps(dy, scale));
+  a.az = _mm_sub_ps(a.az, _mm_mul_ps(dz, scale));
+}
+
+} // namespace
+
+void flockKernelSSE42(FlockSpan const &span, unsigned const *indices,
+                      unsigned count, FlockQuery const &q,
+                      FlockRules const &rules, FlockSums &sums) {
+  Consts c;
+  c.px = _mm_set1_ps(q.px);
+  c.py = _mm_set1_ps(q.py);
+  c.pz = _mm_set1_ps(q.pz);
+  c.hx = _mm_set1_ps(q.hx);
+  c.hy = _mm_set1_ps(q.hy);
+  c.hz = _mm_set1_ps(q.hz);
+  c.seeing = _mm_castsi128_ps(_mm_set1_epi32(q.seeing ? -1 : 0));
+  c.cosHalfFov = _mm_set1_ps(rules.cosHalfFov);
+  c.follow = _mm_set1_ps(rules.follow);
+  c.avoid = _mm_set1_ps(rules.avoid);
+  c.preyScale = _mm_set1_ps(1.f / AVOID_PREY_DIV);
+  c.one = _mm_set1_ps(1.f);
+  c.prey = _mm_set1_epi32(BoidSystem::PREY);
+
+  Accum a;
+  a.n = _mm_setzero_ps();
+  a.sx = a.sy = a.sz = a.n;
+  a.svx = a.svy = a.svz = a.n;
+  a.ax = a.ay = a.az = a.n;
+
+  for (unsigned k = 0; k < count; k += 8) {
+    // the tail reuses a valid index, and a type no rule matches
+    alignas(16) int idx[8];
+    alignas(16) int type[8];
+    for (int l = 0; l < 8; l++) {
+      bool valid = k + l < count;
+      idx[l] = valid ? indices[k + l] : indices[k];
+      type[l] = valid ? span.type[idx[l]] : -1;
+    }
+    lanes4(span, idx, type, c, a);
+    lanes4(span, idx + 4, type + 4, c, a);
+  }
+
+  sums.count += int(horizontalSum(a.n));
+  sums.position[0] += horizontalSum(a.sx);
+  sums.position[1] += horizontalSum(a.sy);
+  sums.position[2] += horizontalSum(a.sz);
+  sums.velocity[0] += horizontalSum(a.svx);
+  sums.velocity[1] += horizontalSum(a.svy);
+  sums.velocity[2] += horizontalSum(a.svz);
+  sums.avoid[0] += horizontalSum(a.ax);
+  sums.avoid[1] += horizontalSum(a.ay);
+  sums.avoid[2] += horizontalSum(a.az);
+}
@@ -0,0 +1,90 @@
+/**
+ * File:	FlockStats.cpp
+ */
+
+#include "FlockStats.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+// boids per partial, large enough that a chunk is worth waking a thread for
+enum { STATS_CHUNK = 4096 };
+
+struct Partial {
+  float position[3];
+  float velocity[3];
+  float min[3];
+  float max[3];
+  unsigned typeCount[2];
+};
+
+} // namespace
+
+FlockStats computeFlockStats(BoidSystem const &boids, ThreadPool &pool) {
+  FlockStats stats;
+  stats.count = boids.size();
+  stats.typeCount[BoidSystem::PREY] = 0;
+  stats.typeCount[BoidSystem::PREDATOR] = 0;
+  stats.centroid = stats.meanVelocity = Vec3f(0, 0, 0);
+  stats.boundsMin = stats.boundsMax = Vec3f(0, 0, 0);
+  if (boids.empty())
+    return stats;
+
+  float const *pos[3] = {boids.x(), boids.y(), boids.z()};
+  float const *vel[3] = {boids.vx(), boids.vy(), boids.vz()};
+  unsigned char const *types = boids.types();
+
+  unsigned numChunks = (stats.count + STATS_CHUNK - 1) / STATS_CHUNK;
+  std::vector<Partial> partials(numChunks);
+
+  pool.parallelFor(numChunks, 1, [&](unsigned begin, unsigned end) {
+    for (unsigned c = begin; c < end; c++) {
+      unsigned first = c * STATS_CHUNK;
+      unsigned last = std::min(first + STATS_CHUNK, stats.count);
+
+      Partial &p = partials[c];
+      p.typeCount[BoidSystem::PREY] = 0;
+      p.typeCount[BoidSystem::PREDATOR] = 0;
+      for (int a = 0; a < 3; a++) {
+        p.position[a] = p.velocity[a] = 0;
+        p.min[a] = p.max[a] = pos[a][first];
+      }
+
+      for (unsigned i = first; i < last; i++) {
+        for (int a = 0; a < 3; a++) {
+          p.position[a] += pos[a][i];
+          p.velocity[a] += vel[a][i];
+          p.min[a] = std::min(p.min[a], pos[a][i]);
+          p.max[a] = std::max(p.max[a], pos[a][i]);
+        }
+        p.typeCount[types[i]]++;
+      }
+    }
+  });
+
+  // combine in chunk order, in double so large flocks don't lose the tail
+  double position[3] = {0, 0, 0};
+  double velocity[3] = {0, 0, 0};
+  stats.boundsMin =
+      Vec3f(partials[0].min[0], partials[0].min[1], partials[0].min[2]);
+  stats.boundsMax =
+      Vec3f(partials[0].max[0], partials[0].max[1], partials[0].max[2]);
+  for (Partial const &p : partials) {
+    for (int a = 0; a < 3; a++) {
+      position[a] += p.position[a];
+      velocity[a] += p.velocity[a];
+      stats.boundsMin[a] = std::min(stats.boundsMin[a], p.min[a]);
+      stats.boundsMax[a] = std::max(stats.boundsMax[a], p.max[a]);
+    }
+    stats.typeCount[BoidSystem::PREY] += p.typeCount[BoidSystem::PREY];
+    stats.typeCount[BoidSystem::PREDATOR] += p.typeCount[BoidSystem::PREDATOR];
+  }
+
+  for (int a = 0; a < 3; a++) {
+    stats.centroid[a] = position[a] / stats.count;
+    stats.meanVelocity[a] = velocity[a] / stats.count;
+  }
+  return stats;
+}
@@ -0,0 +1,46 @@
+/**
+ * File:	Frustum.cpp
+ */
+
+#include "Frustum.h"
+
+Frustum::Frustum() {
+  for (int i = 0; i < 6; i++) {
+    m_normal[i] = Vec3f(0, 0, 0);
+    m_d[i] = 1;
+  }
+}
+
+// clip = VP * p is inside when -w <= x, y, z <= w, so each plane is the
+// last row plus or minus one of the others
+Frustum::Frustum(Mat4f const &vp) {
+  for (int axis = 0; axis < 3; axis++) {
+    for (int sign = 0; sign < 2; sign++) {
+      float s = sign ? -1 : 1;
+      int i = 2 * axis + sign;
+      m_normal[i] = Vec3f(vp(3, 0) + s * vp(axis, 0),
+                          vp(3, 1) + s * vp(axis, 1),
+                          vp(3, 2) + s * vp(axis, 2));
+      m_d[i] = vp(3, 3) + s * vp(axis, 3);
+    }
+  }
+}
+
+Frustum::Side Frustum::classify(Vec3f const &lo, Vec3f const &hi) const {
+  Side side = INSIDE;
+  for (int i = 0; i < 6; i++) {
+    Vec3f const &n = m_normal[i];
+
+    // the corner furthest along the normal, and the one furthest against
+    Vec3f far(n.x() >= 0 ? hi.x() : lo.x(), n.y() >= 0 ? hi.y() : lo.y(),
+              n.z() >= 0 ? hi.z() : lo.z());
+    Vec3f near(n.x() >= 0 ? lo.x() : hi.x(), n.y() >= 0 ? lo.y() : hi.y(),
+               n.z() >= 0 ? lo.z() : hi.z());
+
+    if (n * far + m_d[i] < 0)
+      return OUTSIDE;
+    if (n * near + m_d[i] < 0)
+      side = PARTIAL;
+  }
+  return side;
+}
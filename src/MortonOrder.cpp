@@ -0,0 +1,111 @@
+/**
+ * File:	MortonOrder.cpp
+ */
+
+#include "MortonOrder.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+unsigned const DIGITS = 1u << MortonOrder::DIGIT_BITS;
+
+// Spreads the low 10 bits of v two bits apart
+unsigned spread(unsigned v) {
+  v &= 0x3ff;
+  v = (v | (v << 16)) & 0x030000ff;
+  v = (v | (v << 8)) & 0x0300f00f;
+  v = (v | (v << 4)) & 0x030c30c3;
+  v = (v | (v << 2)) & 0x09249249;
+  return v;
+}
+
+} // namespace
+
+unsigned MortonOrder::code(Vec3f const &p, Vec3f const &lo,
+                           Vec3f const &hi) {
+  unsigned const top = (1u << BITS) - 1;
+  unsigned q[3];
+  for (int a = 0; a < 3; a++) {
+    float extent = hi[a] - lo[a];
+    float t = extent > 0 ? (p[a] - lo[a]) / extent : 0;
+    // not a number ends up in the low corner
+    t = t > 0 ? std::min(t, 1.f) : 0;
+    q[a] = unsigned(t * top);
+  }
+  return spread(q[0]) | (spread(q[1]) << 1) | (spread(q[2]) << 2);
+}
+
+std::vector<unsigned> const &MortonOrder::compute(BoidSystem const &boids,
+                                                  Vec3f const &lo,
+                                                  Vec3f const &hi,
+                                                  ThreadPool &pool) {
+  unsigned n = boids.size();
+  unsigned numChunks = (n + CHUNK - 1) / CHUNK;
+  for (int b = 0; b < 2; b++) {
+    m_codes[b].resize(n);
+    m_order[b].resize(n);
+  }
+  m_counts.resize(numChunks * DIGITS);
+  if (n == 0)
+    return m_order[0];
+
+  pool.parallelFor(n, CHUNK, [&](unsigned begin, unsigned end) {
+    for (unsigned i = begin; i < end; i++) {
+      m_codes[0][i] = code(boids.position(i), lo, hi);
+      m_order[0][i] = i;
+    }
+  });
+
+  // every pass reads buffer `in` and writes the other
+  int in = 0;
+  for (unsigned shift = 0; shift < 3 * BITS; shift += DIGIT_BITS) {
+    std::vector<unsigned> const &codes = m_codes[in];
+    std::vector<unsigned> const &order = m_order[in];
+    std::vector<unsigned> &codesOut = m_codes[in ^ 1];
+    std::vector<unsigned> &orderOut = m_order[in ^ 1];
+
+    pool.parallelFor(numChunks, 1, [&](unsigned begin, unsigned end) {
+      for (unsigned c = begin; c < end; c++) {
+        unsigned *count = &m_counts[c * DIGITS];
+        std::fill(count, count + DIGITS, 0);
+        unsigned last = std::min((c + 1) * CHUNK, n);
+        for (unsigned k = c * CHUNK; k < last; k++)
+          count[(codes[k] >> shift) & (DIGITS - 1)]++;
+      }
+    });
+
+    // a digit every boid shares leaves the order as it is
+    unsigned total = 0;
+    for (unsigned c = 0; c < numChunks; c++)
+      total += m_counts[c * DIGITS + ((codes[0] >> shift) & (DIGITS - 1))];
+    if (total == n)
+      continue;
+
+    // counts become where each chunk starts writing each digit, digit
+    // major so the scatter stays stable
+    unsigned start = 0;
+    for (unsigned d = 0; d < DIGITS; d++)
+      for (unsigned c = 0; c < numChunks; c++) {
+        unsigned count = m_counts[c * DIGITS + d];
+        m_counts[c * DIGITS + d] = start;
+        start += count;
+      }
+
+    pool.parallelFor(numChunks, 1, [&](unsigned begin, unsigned end) {
+      for (unsigned c = begin; c < end; c++) {
+        unsigned *next = &m_counts[c * DIGITS];
+        unsigned last = std::min((c + 1) * CHUNK, n);
+        for (unsigned k = c * CHUNK; k < last; k++) {
+          unsigned to = next[(codes[k] >> shift) & (DIGITS - 1)]++;
+          codesOut[to] = codes[k];
+          orderOut[to] = order[k];
+        }
+      }
+    });
+    in ^= 1;
+  }
+
+  return m_order[in];
+}
@@ -0,0 +1,45 @@
+/**
+ * File:	NeighbourLists.cpp
+ */
+
+#include "NeighbourLists.h"
+
+void NeighbourLists::clear() {
+  m_built = false;
+  m_usable = false;
+  m_indices.clear();
+  m_start.clear();
+}
+
+bool NeighbourLists::stale(BoidSystem const &boids, float reach, float skin,
+                           ThreadPool &pool) {
+  unsigned n = boids.size();
+  if (!m_built || m_x.size() != n || reach != m_reach || skin != m_skin)
+    return true;
+
+  float const *x = boids.x(), *y = boids.y(), *z = boids.z();
+  unsigned char const *types = boids.types();
+
+  // largest squared move of any prey, per chunk then overall
+  unsigned numChunks = (n + CHUNK - 1) / CHUNK;
+  m_chunkMoved.assign(numChunks, 0);
+
+  pool.parallelFor(numChunks, 16, [&](unsigned begin, unsigned end) {
+    for (unsigned c = begin; c < end; c++) {
+      float moved = 0;
+      unsigned last = std::min((c + 1) * CHUNK, n);
+      for (unsigned i = c * CHUNK; i < last; i++) {
+        float dx = x[i] - m_x[i], dy = y[i] - m_y[i], dz = z[i] - m_z[i];
+        if (types[i] == BoidSystem::PREY)
+          moved = std::max(moved, dx * dx + dy * dy + dz * dz);
+      }
+      m_chunkMoved[c] = moved;
+    }
+  });
+
+  float moved = 0;
+  for (float m : m_chunkMoved)
+    moved = std::max(moved, m);
+
+  return moved > skin * skin / 4;
+}
@@ -0,0 +1,41 @@
+/**
+ * File:	Obstacles.cpp
+ */
+
+#include "Obstacles.h"
+
+#include <algorithm>
+
+void Obstacles::clear() { m_segments.clear(); }
+
+void Obstacles::addSegment(Vec3f const &a, Vec3f const &b) {
+  Segment s;
+  s.a = a;
+  s.b = b;
+  m_segments.push_back(s);
+}
+
+Vec3f Obstacles::closestPoint(unsigned i, Vec3f const &p) const {
+  Segment const &s = m_segments[i];
+  Vec3f ab = s.b - s.a;
+  float len2 = ab.lengthSquared();
+  if (len2 == 0)
+    return s.a;
+
+  float t = ((p - s.a) * ab) / len2;
+  t = std::min(1.f, std::max(0.f, t));
+  return s.a + ab * t;
+}
+
+Vec3f Obstacles::avoidance(Vec3f const &p, float range) const {
+  Vec3f push(0, 0, 0);
+  float range2 = range * range;
+
+  for (unsigned i = 0; i < m_segments.size(); i++) {
+    Vec3f away = p - closestPoint(i, p);
+    if (away.lengthSquared() < range2)
+      push += away;
+  }
+
+  return push;
+}
@@ -0,0 +1,194 @@
+/**
+ * File:	Octree.cpp
+ */
+
+#include "Octree.h"
+
+#include <algorithm>
+#include <limits>
+
+void Octree::build(float const *x, float const *y, float const *z,
+                   unsigned n, float radius) {
+  float const *const axes[3] = {x, y, z};
+
+  m_indices.clear();
+  m_indices.reserve(n);
+  for (unsigned i = 0; i < n; i++)
+    if (std::isfinite(x[i]) && std::isfinite(y[i]) && std::isfinite(z[i]))
+      m_indices.push_back(i);
+  m_scratch.resize(m_indices.size());
+  m_octant.resize(m_indices.size());
+
+  m_nodes.clear();
+  m_runs.clear();
+  m_leafOf.assign(n, NO_LEAF);
+  m_depth = 0;
+  if (m_indices.empty())
+    return;
+
+  Node root;
+  root.begin = 0;
+  root.end = m_indices.size();
+  m_nodes.push_back(root);
+  split(0, 0, axes);
+  findLeafRuns(radius);
+}
+
+namespace {
+
+// top bit of an entry of m_reach, set when all of the node is in reach
+unsigned const WHOLE = 1u << 31;
+
+} // namespace
+
+// Walks down from the root, each node handing its children the nodes
+// within radius of its box. A child's box lies inside its parent's, so it
+// only has to drop the ones it no longer reaches and open the ones it
+// reaches in part, and every leaf ends up with its runs without a walk of
+// its own from the root.
+void Octree::findLeafRuns(float radius) {
+  m_reach.assign(1, 0);
+  gatherRuns(0, 0, radius * radius);
+}
+
+// m_reach from `from` on holds the nodes the parent of node reaches
+void Octree::gatherRuns(unsigned node, unsigned from, float r2) {
+  Node const &self = m_nodes[node];
+  bool leaf = self.numChildren == 0;
+
+  // a branch opens what it partly reaches one level and leaves the rest
+  // to its children, a leaf opens it all the way down
+  unsigned to = m_reach.size();
+  for (unsigned k = from; k < to; k++)
+    keepInReach(self, m_reach[k], r2, leaf ? unsigned(MAX_DEPTH) : 1u);
+
+  if (!leaf) {
+    for (unsigned c = 0; c < self.numChildren; c++)
+      gatherRuns(self.firstChild + c, to, r2);
+    m_reach.resize(to);
+    return;
+  }
+
+  for (unsigned k = self.begin; k < self.end; k++)
+    m_leafOf[m_indices[k]] = node;
+
+  // opening a node puts its children in its place, so the nodes are
+  // still in index order and their runs join where they touch
+  m_nodes[node].firstRun = m_runs.size();
+  for (unsigned k = to; k < m_reach.size(); k++) {
+    Node const &other = m_nodes[m_reach[k] & ~WHOLE];
+    if (m_runs.size() > self.firstRun && m_runs.back().end == other.begin)
+      m_runs.back().end = other.end;
+    else
+      m_runs.push_back(Run{other.begin, other.end});
+  }
+  m_nodes[node].numRuns = m_runs.size() - self.firstRun;
+  m_reach.resize(to);
+}
+
+// Appends other to m_reach if it comes within reach of node, flagged
+// WHOLE when all of it does. A branch it only partly reaches is opened
+// instead, up to levels deep.
+void Octree::keepInReach(Node const &node, unsigned other, float r2,
+                         unsigned levels) {
+  if (other & WHOLE) {
+    m_reach.push_back(other);
+    return;
+  }
+
+  // nearest and furthest any two points of the bounds can be
+  Node const &box = m_nodes[other];
+  float near2 = 0, far2 = 0;
+  for (int a = 0; a < 3; a++) {
+    float d = std::max(std::max(box.lo[a] - node.hi[a],
+                                node.lo[a] - box.hi[a]), 0.f);
+    float f = std::max(box.hi[a] - node.lo[a], node.hi[a] - box.lo[a]);
+    near2 += d * d;
+    far2 += f * f;
+  }
+
+  if (near2 > r2)
+    return;
+  if (far2 <= r2)
+    m_reach.push_back(other | WHOLE);
+  else if (box.numChildren == 0 || levels == 0)
+    m_reach.push_back(other);
+  else
+    for (unsigned c = 0; c < box.numChildren; c++)
+      keepInReach(node, box.firstChild + c, r2, levels - 1);
+}
+
+// Fits the node's bounds to its boids, then splits it into the octants
+// around the middle of them, recursing into each non empty one
+void Octree::split(unsigned node, unsigned depth,
+                   float const *const axes[3]) {
+  unsigned begin = m_nodes[node].begin;
+  unsigned end = m_nodes[node].end;
+
+  float big = std::numeric_limits<float>::max();
+  Vec3f lo(big, big, big);
+  Vec3f hi(-big, -big, -big);
+  for (unsigned k = begin; k < end; k++) {
+    unsigned i = m_indices[k];
+    for (int a = 0; a < 3; a++) {
+      lo[a] = std::min(lo[a], axes[a][i]);
+      hi[a] = std::max(hi[a], axes[a][i]);
+    }
+  }
+  m_nodes[node].lo = lo;
+  m_nodes[node].hi = hi;
+  m_nodes[node].firstChild = 0;
+  m_nodes[node].numChildren = 0;
+  m_nodes[node].firstRun = 0;
+  m_nodes[node].numRuns = 0;
+  m_depth = std::max(m_depth, depth);
+
+  if (end - begin <= LEAF_SIZE || depth == MAX_DEPTH || lo == hi) {
+    // in memory order, for the gathers of whoever walks the leaf
+    std::sort(m_indices.begin() + begin, m_indices.begin() + end);
+    return;
+  }
+
+  // counting sort of the node's run by octant, bit a set for the upper
+  // half of axis a
+  Vec3f mid = (lo + hi) * 0.5f;
+  unsigned count[8] = {};
+  for (unsigned k = begin; k < end; k++) {
+    unsigned i = m_indices[k];
+    unsigned octant = 0;
+    for (int a = 0; a < 3; a++)
+      if (axes[a][i] > mid[a])
+        octant |= 1u << a;
+    m_octant[k] = octant;
+    count[octant]++;
+  }
+
+  unsigned start[8];
+  unsigned fill[8];
+  start[0] = begin;
+  for (int o = 1; o < 8; o++)
+    start[o] = start[o - 1] + count[o - 1];
+  std::copy(start, start + 8, fill);
+
+  // scattered into the same run of the scratch array, then copied back
+  for (unsigned k = begin; k < end; k++)
+    m_scratch[fill[m_octant[k]]++] = m_indices[k];
+  std::copy(m_scratch.begin() + begin, m_scratch.begin() + end,
+            m_indices.begin() + begin);
+
+  unsigned firstChild = m_nodes.size();
+  for (int o = 0; o < 8; o++) {
+    if (count[o] == 0)
+      continue;
+    Node child;
+    child.begin = start[o];
+    child.end = start[o] + count[o];
+    m_nodes.push_back(child);
+  }
+  unsigned lastChild = m_nodes.size();
+  m_nodes[node].firstChild = firstChild;
+  m_nodes[node].numChildren = lastChild - firstChild;
+
+  for (unsigned c = firstChild; c < lastChild; c++)
+    split(c, depth + 1, axes);
+}
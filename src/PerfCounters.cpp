@@ -0,0 +1,111 @@
+/**
+ * File:	PerfCounters.cpp
+ */
+
+#include "PerfCounters.h"
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+char const *PerfCounters::eventName(Event event) {
+  switch (event) {
+  case CACHE_REFERENCES:
+    return "cache references";
+  case CACHE_MISSES:
+    return "cache misses";
+  case L1D_READ_MISSES:
+    return "L1D read misses";
+  default:
+    return "unknown";
+  }
+}
+
+#ifdef __linux__
+
+PerfCounters::PerfCounters() {
+  unsigned long long const l1dReadMiss =
+      PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  struct {
+    unsigned type;
+    unsigned long long config;
+  } const events[EVENTS] = {
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+      {PERF_TYPE_HW_CACHE, l1dReadMiss},
+  };
+
+  for (int e = 0; e < EVENTS; e++) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = events[e].type;
+    attr.config = events[e].config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    // this thread, on any cpu
+    m_fd[e] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (m_fd[e] < 0 && m_error.empty())
+      m_error = std::string("perf_event_open: ") + std::strerror(errno);
+  }
+}
+
+PerfCounters::~PerfCounters() {
+  for (int fd : m_fd)
+    if (fd >= 0)
+      close(fd);
+}
+
+void PerfCounters::start() {
+  for (int fd : m_fd)
+    if (fd >= 0) {
+      ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+void PerfCounters::stop() {
+  for (int fd : m_fd)
+    if (fd >= 0)
+      ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+}
+
+unsigned long long PerfCounters::count(Event event) const {
+  unsigned long long value = 0;
+  if (m_fd[event] < 0 ||
+      read(m_fd[event], &value, sizeof(value)) != sizeof(value))
+    return 0;
+  return value;
+}
+
+#else
+
+PerfCounters::PerfCounters() : m_error("no perf_event_open on this system") {
+  for (int &fd : m_fd)
+    fd = -1;
+}
+
+PerfCounters::~PerfCounters() {}
+void PerfCounters::start() {}
+void PerfCounters::stop() {}
+unsigned long long PerfCounters::count(Event) const { return 0; }
+
+#endif
+
+bool PerfCounters::available() const {
+  for (int fd : m_fd)
+    if (fd >= 0)
+      return true;
+  return false;
+}
+
+std::string const &PerfCounters::error() const { return m_error; }
+bool PerfCounters::has(Event event) const { return m_fd[event] >= 0; }
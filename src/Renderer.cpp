@@ -0,0 +1,81 @@
+/**
+ * File:	Renderer.cpp
+ */
+
+#include "Renderer.h"
+
+#include <cstddef>
+#include <cstring>
+
+Renderer::Renderer()
+    : m_frameBuffer(0), m_program(0), m_vao(0), m_skippedBinds(0) {
+  std::memset(&m_frame, 0, sizeof(m_frame));
+}
+
+void Renderer::create() {
+  glGenBuffers(1, &m_frameBuffer);
+  glBindBuffer(GL_UNIFORM_BUFFER, m_frameBuffer);
+  glBufferData(GL_UNIFORM_BUFFER, sizeof(Frame), &m_frame, GL_DYNAMIC_DRAW);
+  glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_BINDING, m_frameBuffer);
+
+  invalidate();
+  m_skippedBinds = 0;
+}
+
+void Renderer::destroy() {
+  glDeleteBuffers(1, &m_frameBuffer);
+  m_frameBuffer = 0;
+}
+
+void Renderer::attach(GLuint program) {
+  GLuint block = glGetUniformBlockIndex(program, "Frame");
+  if (block != GL_INVALID_INDEX)
+    glUniformBlockBinding(program, block, FRAME_BINDING);
+}
+
+void Renderer::useProgram(GLuint program) {
+  if (program == m_program) {
+    m_skippedBinds++;
+    return;
+  }
+  glUseProgram(program);
+  m_program = program;
+}
+
+void Renderer::bindVertexArray(GLuint vao) {
+  if (vao == m_vao) {
+    m_skippedBinds++;
+    return;
+  }
+  glBindVertexArray(vao);
+  m_vao = vao;
+}
+
+void Renderer::invalidate() {
+  // no object has id -1, the next bind always goes through
+  m_program = GLuint(-1);
+  m_vao = GLuint(-1);
+}
+
+void Renderer::upload(GLintptr offset, GLsizeiptr size, void const *data) {
+  glBindBuffer(GL_UNIFORM_BUFFER, m_frameBuffer);
+  glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+}
+
+void Renderer::setMVP(Mat4f const &mvp) {
+  if (std::memcmp(m_frame.mvp, mvp.data(), sizeof(m_frame.mvp)) == 0)
+    return;
+
+  std::memcpy(m_frame.mvp, mvp.data(), sizeof(m_frame.mvp));
+  upload(offsetof(Frame, mvp), sizeof(m_frame.mvp), m_frame.mvp);
+}
+
+void Renderer::setColors(Vec3f const &glyph, Vec3f const &heading) {
+  float colors[8] = {glyph.x(),   glyph.y(),   glyph.z(),   1,
+                     heading.x(), heading.y(), heading.z(), 1};
+  if (std::memcmp(m_frame.glyphColor, colors, sizeof(colors)) == 0)
+    return;
+
+  std::memcpy(m_frame.glyphColor, colors, sizeof(colors));
+  upload(offsetof(Frame, glyphColor), sizeof(colors), m_frame.glyphColor);
+}
@@ -0,0 +1,370 @@
+/**
+ * File:	Simulation.cpp
+ *
+ * Summary:
+ *
+ * The flocking rules, written by Rukiya Hassan, moved out of main.cpp.
+ */
+
+#include "Simulation.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <thread>
+
+#include "FlockKernel.h"
+
+float const Simulation::WALL_SPACING = 10;
+float const Simulation::DEFAULT_VERLET_SKIN = 10;
+
+static float const pi = 3.1459265359;
+
+// separation radius, boids closer than this are avoided
+static float const avo = 15;
+
+Simulation::Simulation(unsigned numThreads)
+    : m_followTarget(false), m_target(0, 0, 0), m_search(SEARCH_GRID),
+      m_incrementalGrid(true), m_gridLayout(~0ul), m_indexCurrent(false),
+      m_indexReach(0), m_verletSkin(0),
+      m_mortonInterval(DEFAULT_MORTON_INTERVAL), m_stepsSinceSort(~0u),
+      m_mortonSorts(0), m_pool(numThreads) {
+  m_stats = computeFlockStats(m_boids, m_pool);
+}
+
+void Simulation::setup(unsigned numBoids, unsigned numPreds) {
+  float x, y, z;
+  int dist = 100;
+  int distbtwn = dist/2;
+  m_boids.clear();
+  m_boids.reserve(numBoids + numPreds);
+  for (unsigned i = 0; i < numBoids; i++) {
+    x = (rand()%20)-10;
+    y = (rand()%20)-10;
+    z = (rand()%20)-10;
+
+    Vec3f position(rand()%dist-distbtwn, rand()%dist-distbtwn, rand()%dist-distbtwn);
+    m_boids.add(position, Vec3f(x,y,z), BoidSystem::PREY);
+  }
+
+  for (unsigned i = 0; i < numPreds; i++) {
+    x = (rand()%20)-10;
+    y = (rand()%20)-10;
+    z = (rand()%20)-10;
+
+    Vec3f position(rand()%dist-distbtwn, rand()%dist-distbtwn, rand()%dist-distbtwn);
+    m_boids.add(position, Vec3f(x, y, z), BoidSystem::PREDATOR);
+  }
+
+  // a post through the flock, where the 100 wall boids used to stand
+  int border = m_params.border;
+  m_obstacles.clear();
+  m_obstacles.addSegment(Vec3f(-border/2, -50*WALL_SPACING, -border/2),
+                         Vec3f(-border/2, 49*WALL_SPACING, -border/2));
+
+  m_stats = computeFlockStats(m_boids, m_pool);
+  m_indexCurrent = false;
+  m_lists.clear();
+  m_stepsSinceSort = ~0u;
+  m_changed.add(0, m_boids.size());
+}
+
+// make them be pulled into centre by a "force" when exit boundaries
+void Simulation::boundaries(Vec3f p, Vec3f &velocity) const {
+  float turn = 0.05;
+  int border = m_params.border;
+
+  if (p.x() >= border)
+    velocity.x() += -turn;
+  else if (p.x() < -border)
+    velocity.x() += turn;
+
+  if (p.y() >= border)
+    velocity.y()  += -turn;
+  else if (p.y() < -border)
+    velocity.y() += turn;
+
+  if (p.z() >= border)
+    velocity.z() += -turn;
+  else if (p.z() < -border)
+    velocity.z() += turn;
+
+}
+
+// furthest a boid looks for the prey it flocks with. Predators scare from
+// further, but they do the looking themselves, see step()
+float Simulation::reach() const { return std::max(float(m_params.fol), avo); }
+
+char const *Simulation::neighbourSearchName(NeighbourSearch search) {
+  switch (search) {
+  case SEARCH_GRID:
+    return "grid";
+  case SEARCH_OCTREE:
+    return "octree";
+  default:
+    return "brute force";
+  }
+}
+
+void Simulation::buildIndex(float reach) {
+  BoidSystem const &boids = m_boids;
+  switch (m_search) {
+  case SEARCH_GRID:
+    // the grid holds boid indices, only good to update while they still
+    // name the same boids
+    if (m_incrementalGrid && m_gridLayout == boids.layout())
+      m_grid.update(boids.x(), boids.y(), boids.z(), boids.size(), reach,
+                    m_pool);
+    else
+      m_grid.build(boids.x(), boids.y(), boids.z(), boids.size(), reach,
+                   m_pool);
+    m_gridLayout = boids.layout();
+    break;
+  case SEARCH_OCTREE:
+    m_octree.build(boids.x(), boids.y(), boids.z(), boids.size(), reach);
+    break;
+  default:
+    if (m_allBoids.size() != boids.size()) {
+      m_allBoids.resize(boids.size());
+      for (unsigned j = 0; j < boids.size(); j++)
+        m_allBoids[j] = j;
+    }
+    break;
+  }
+  m_indexCurrent = true;
+  m_indexReach = reach;
+}
+
+// Boids move into the order of their Morton codes within the flock
+// bounds. Whatever was kept per index is rebuilt for the new order.
+void Simulation::sortByMorton() {
+  m_boids.permute(
+      m_morton.compute(m_boids, m_stats.boundsMin, m_stats.boundsMax, m_pool),
+      m_pool);
+  m_indexCurrent = false;
+  m_lists.clear();
+  m_changed.add(0, m_boids.size());
+  m_stepsSinceSort = 0;
+  m_mortonSorts++;
+}
+
+unsigned long long Simulation::candidatePairs() {
+  unsigned long long n = m_boids.size();
+  if (m_search == SEARCH_BRUTE)
+    return n * n;
+
+  float reach = this->reach();
+  buildIndex(reach);
+
+  // the lists the step would walk, if it would not rebuild them first
+  bool lists = m_verletSkin > 0 && m_lists.usable() &&
+               !m_lists.stale(m_boids, reach, m_verletSkin, m_pool);
+  unsigned char const *types = m_boids.types();
+
+  unsigned long long pairs = 0;
+  auto add = [&](unsigned const *, unsigned count) { pairs += count; };
+  for (unsigned i = 0; i < n; i++) {
+    if (lists && types[i] == BoidSystem::PREY)
+      m_lists.forEachSpanOf(i, add);
+    else
+      forEachCandidateOf(i, m_boids.position(i), reach, add);
+  }
+  return pairs;
+}
+
+void Simulation::step() {
+  float preyMaxSpeed = 1;
+  float predMaxSpeed = 3;
+  float phi = m_params.fov/2 * pi/180;
+
+  FlockRules rules;
+  rules.follow = m_params.fol;
+  rules.avoid = avo;
+  rules.cosHalfFov = cos(phi);
+
+  m_stats = computeFlockStats(m_boids, m_pool);
+
+  if (m_mortonInterval > 0 && m_stepsSinceSort >= m_mortonInterval)
+    sortByMorton();
+  if (m_stepsSinceSort != ~0u)
+    m_stepsSinceSort++;
+
+  float reach = this->reach();
+  float predatorRange = avo * PREDATOR_RANGE_SCALE;
+
+  // the last step left an index over these positions, unless the flock
+  // was replaced, boids were moved since, or the search or the reach
+  // changed
+  BoidSystem &boids = m_boids;
+  if (!m_indexCurrent || m_indexReach != reach)
+    buildIndex(reach);
+
+  // prey walk their Verlet lists instead, rebuilt from the index once some
+  // prey has moved too far for them
+  bool lists = false;
+  if (m_verletSkin > 0) {
+    if (m_lists.stale(boids, reach, m_verletSkin, m_pool))
+      m_lists.build(boids, reach, m_verletSkin, m_pool,
+                    [&](Vec3f const &p, float radius,
+                        NeighbourLists::Collect const &collect) {
+                      forEachCandidate(p, radius, collect);
+                    });
+    lists = m_lists.usable();
+  }
+
+  // predators are few, so instead of every boid looking for them, each
+  // predator pushes away the boids within its range
+  if (m_scare.size() != boids.size())
+    m_scare.assign(boids.size(), Vec3f(0, 0, 0));
+
+  for (unsigned p : boids.predators()) {
+    Vec3f predator = boids.position(p);
+    auto push = [&](unsigned j) {
+      Vec3f away = boids.position(j) - predator;
+      if (away.length() < predatorRange) {
+        m_scare[j] += away * (1.f / AVOID_PREDATOR_DIV);
+        m_scared.push_back(j);
+      }
+    };
+
+    forEachCandidate(predator, predatorRange,
+                     [&](unsigned const *indices, unsigned count) {
+                       for (unsigned k = 0; k < count; k++)
+                         push(indices[k]);
+                     });
+  }
+
+  // everyone reads the front state and writes the back one, so boids can
+  // be updated in any order, on any thread
+  BoidSystem::Arrays next = boids.back();
+
+  FlockKernel kernel = flockKernel();
+  FlockSpan span = flockSpan(boids);
+  unsigned char const *types = boids.types();
+
+  auto update = [&](unsigned begin, unsigned end) {
+    for (unsigned i = begin; i < end; i++) {
+      Vec3f position = boids.position(i);
+      Vec3f velocity = boids.velocity(i);
+      Vec3f avgVelocity, avgPos, avoVector, direct;
+
+      Vec3f heading = boids.heading(i);
+      FlockQuery query;
+      query.px = position.x();
+      query.py = position.y();
+      query.pz = position.z();
+      query.hx = heading.x();
+      query.hy = heading.y();
+      query.hz = heading.z();
+      query.seeing = heading.lengthSquared() > 0;
+
+      FlockSums sums = {};
+      auto visit = [&](unsigned const *indices, unsigned count) {
+        kernel(span, indices, count, query, rules, sums);
+      };
+
+      if (lists && types[i] == BoidSystem::PREY)
+        m_lists.forEachSpanOf(i, visit);
+      else
+        forEachCandidateOf(i, position, reach, visit);
+
+      int numNeighbours = sums.count;
+      avgPos = Vec3f(sums.position[0], sums.position[1], sums.position[2]);
+      avgVelocity = Vec3f(sums.velocity[0], sums.velocity[1], sums.velocity[2]);
+      avoVector = Vec3f(sums.avoid[0], sums.avoid[1], sums.avoid[2]);
+      avoVector += m_scare[i];
+      avoVector += m_obstacles.avoidance(position, avo) / AVOID_WALL_DIV;
+
+      // following mouse behaviour
+      if (m_followTarget)
+        direct = (m_target - position) / 1000;  // directed by mouse movement
+
+      // found another behaviour
+      if (numNeighbours > 0) {
+        avgPos = ((avgPos/numNeighbours)-position) / 150;
+        avgVelocity = ((avgVelocity/numNeighbours)-velocity) / 8;
+      }
+      velocity += avgPos + avgVelocity + avoVector + direct;
+      if (types[i] == BoidSystem::PREDATOR)
+        velocity += avoVector + avgPos;
+      // stay within boundaries
+      boundaries(position, velocity);
+
+      // limit speed
+      float speed = velocity.length();
+      if (speed > preyMaxSpeed && types[i] == BoidSystem::PREY) {
+        velocity = ((velocity / speed) * preyMaxSpeed);
+        speed = preyMaxSpeed;
+      } else if (speed > predMaxSpeed && types[i] == BoidSystem::PREDATOR) {
+        velocity = ((velocity / speed) * predMaxSpeed);
+        speed = predMaxSpeed;
+      }
+
+      // update movement
+      position += velocity;
+      // face where we are going, keep the old heading when standing still
+      if (speed > 0)
+        heading = velocity / speed;
+
+      next.x[i] = position.x();
+      next.y[i] = position.y();
+      next.z[i] = position.z();
+      next.vx[i] = velocity.x();
+      next.vy[i] = velocity.y();
+      next.vz[i] = velocity.z();
+      next.hx[i] = heading.x();
+      next.hy[i] = heading.y();
+      next.hz[i] = heading.z();
+    } // end loop for i
+  };
+
+  m_pool.parallelFor(boids.size(), 64, update);
+  boids.swap();
+  m_changed.add(0, boids.size());
+
+  for (unsigned j : m_scared)
+    m_scare[j] = Vec3f(0, 0, 0);
+  m_scared.clear();
+
+  // for the next step, and for whoever wants the boids by cell until then
+  buildIndex(reach);
+}
+
+void Simulation::scalingReport(std::ostream &out) {
+  BoidSystem saved = m_boids;
+  unsigned threads = m_pool.size();
+  unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+  int steps = 10;
+  double base = 0;
+
+  out << "scaling, " << m_boids.size() << " boids, " << steps << " steps"
+      << std::endl;
+  out << "threads\tms/step\tspeedup" << std::endl;
+  for (unsigned n = 1;; n = std::min(n * 2, cores)) {
+    m_pool.resize(n);
+    m_boids = saved;
+    m_indexCurrent = false;
+    m_gridLayout = ~0ul;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int s = 0; s < steps; s++)
+      step();
+    std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    double ms = elapsed.count() / steps;
+    if (n == 1)
+      base = ms;
+    out << n << "\t" << ms << "\t" << base / ms << std::endl;
+
+    if (n == cores)
+      break;
+  }
+
+  m_boids = saved;
+  m_indexCurrent = false;
+  m_gridLayout = ~0ul;
+  m_changed.add(0, m_boids.size());
+  m_pool.resize(threads);
+}
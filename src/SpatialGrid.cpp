@@ -0,0 +1,317 @@
+/**
+ * File:	SpatialGrid.cpp
+ */
+
+#include "SpatialGrid.h"
+
+#include <limits>
+#include <algorithm>
+
+#include "ThreadPool.h"
+
+namespace {
+
+// boids per task of the bounds and scatter passes, cells per block of the
+// prefix sum
+enum { BUILD_GRAIN = 8192, SCAN_BLOCK = 16384 };
+
+struct Bounds {
+  float lo[3], hi[3];
+};
+
+} // namespace
+
+SpatialGrid::SpatialGrid()
+    : m_cellSize(1), m_min(0, 0, 0), m_overLo(0, 0, 0), m_overHi(0, 0, 0),
+      m_builtCellSize(0), m_migrated(0), m_rebuilt(false), m_countSize(0) {
+  m_dim[0] = m_dim[1] = m_dim[2] = 1;
+}
+
+void SpatialGrid::build(float const *x, float const *y, float const *z,
+                        unsigned n, float cellSize, ThreadPool &pool) {
+  float const *axes[3] = {x, y, z};
+
+  // bounds of everything this step, boids are free to leave the border,
+  // a partial per chunk
+  float big = std::numeric_limits<float>::max();
+  unsigned numChunks = (n + BUILD_GRAIN - 1) / BUILD_GRAIN;
+  std::vector<Bounds> partials(numChunks);
+  pool.parallelFor(numChunks, 1, [&](unsigned begin, unsigned end) {
+    for (unsigned c = begin; c < end; c++) {
+      Bounds &b = partials[c];
+      for (int a = 0; a < 3; a++) {
+        b.lo[a] = big;
+        b.hi[a] = -big;
+      }
+      unsigned last = std::min((c + 1) * BUILD_GRAIN, n);
+      for (unsigned i = c * BUILD_GRAIN; i < last; i++) {
+        for (int a = 0; a < 3; a++) {
+          float v = axes[a][i];
+          if (std::isfinite(v)) {
+            b.lo[a] = std::min(b.lo[a], v);
+            b.hi[a] = std::max(b.hi[a], v);
+          }
+        }
+      }
+    }
+  });
+
+  Vec3f lo(big, big, big);
+  Vec3f hi(-big, -big, -big);
+  for (Bounds const &b : partials)
+    for (int a = 0; a < 3; a++) {
+      lo[a] = std::min(lo[a], b.lo[a]);
+      hi[a] = std::max(hi[a], b.hi[a]);
+    }
+  if (lo.x() > hi.x())
+    lo = hi = Vec3f(0, 0, 0);
+
+  // never smaller than the query radius, bigger if the flock is spread out
+  // over more than MAX_DIM cells on some axis
+  m_cellSize = cellSize;
+  for (int a = 0; a < 3; a++)
+    m_cellSize = std::max(m_cellSize, (hi[a] - lo[a]) / (MAX_DIM - 1));
+  m_min = lo;
+  for (int a = 0; a < 3; a++)
+    m_dim[a] = int((hi[a] - lo[a]) / m_cellSize) + 1;
+
+  // counting sort by cell: histogram, prefix sum, scatter
+  unsigned cells = numCells();
+  m_cellStart.resize(cells + 1);
+  m_indices.resize(n);
+  m_cellOf.resize(n);
+  m_rank.resize(n);
+  if (m_countSize < cells) {
+    m_count.reset(new std::atomic<unsigned>[cells]);
+    m_countSize = cells;
+  }
+
+  pool.parallelFor(cells, SCAN_BLOCK, [&](unsigned begin, unsigned end) {
+    for (unsigned c = begin; c < end; c++)
+      m_count[c].store(0, std::memory_order_relaxed);
+  });
+
+  // the counter hands each boid its rank in the cell, the order threads
+  // arrive in. Nothing reads the counts until parallelFor returns, so
+  // relaxed is enough.
+  pool.parallelFor(n, BUILD_GRAIN, [&](unsigned begin, unsigned end) {
+    for (unsigned i = begin; i < end; i++) {
+      int c = 0;
+      if (std::isfinite(x[i]) && std::isfinite(y[i]) && std::isfinite(z[i]))
+        c = cellIndex(cellCoord(x[i], 0), cellCoord(y[i], 1),
+                      cellCoord(z[i], 2));
+      m_cellOf[i] = c;
+      m_rank[i] = m_count[c].fetch_add(1, std::memory_order_relaxed);
+    }
+  });
+
+  // exclusive prefix sum of the counts: each block's total, a scan over
+  // the few block totals, then each block's own scan from its offset
+  unsigned numBlocks = (cells + SCAN_BLOCK - 1) / SCAN_BLOCK;
+  m_blockSum.resize(numBlocks + 1);
+  pool.parallelFor(numBlocks, 1, [&](unsigned begin, unsigned end) {
+    for (unsigned b = begin; b < end; b++) {
+      unsigned sum = 0;
+      unsigned last = std::min((b + 1) * SCAN_BLOCK, cells);
+      for (unsigned c = b * SCAN_BLOCK; c < last; c++)
+        sum += m_count[c].load(std::memory_order_relaxed);
+      m_blockSum[b + 1] = sum;
+    }
+  });
+  m_blockSum[0] = 0;
+  for (unsigned b = 0; b < numBlocks; b++)
+    m_blockSum[b + 1] += m_blockSum[b];
+
+  pool.parallelFor(numBlocks, 1, [&](unsigned begin, unsigned end) {
+    for (unsigned b = begin; b < end; b++) {
+      unsigned start = m_blockSum[b];
+      unsigned last = std::min((b + 1) * SCAN_BLOCK, cells);
+      for (unsigned c = b * SCAN_BLOCK; c < last; c++) {
+        m_cellStart[c] = start;
+        start += m_count[c].load(std::memory_order_relaxed);
+      }
+    }
+  });
+  m_cellStart[cells] = n;
+
+  pool.parallelFor(n, BUILD_GRAIN, [&](unsigned begin, unsigned end) {
+    for (unsigned i = begin; i < end; i++)
+      m_indices[m_cellStart[m_cellOf[i]] + m_rank[i]] = i;
+  });
+
+  // one thread hands out ranks in index order, more only roughly
+  if (pool.size() > 1)
+    pool.parallelFor(cells, SCAN_BLOCK, [&](unsigned begin, unsigned end) {
+      for (unsigned c = begin; c < end; c++) {
+        auto first = m_indices.begin() + m_cellStart[c];
+        auto last = m_indices.begin() + m_cellStart[c + 1];
+        if (!std::is_sorted(first, last))
+          std::sort(first, last);
+      }
+    });
+
+  // the bounds hold every boid
+  m_overLo = m_overHi = Vec3f(0, 0, 0);
+  m_builtCellSize = cellSize;
+  m_migrated = n;
+  m_rebuilt = true;
+}
+
+void SpatialGrid::update(float const *x, float const *y, float const *z,
+                         unsigned n, float cellSize, ThreadPool &pool) {
+  if (cellSize != m_builtCellSize || n != m_cellOf.size()) {
+    build(x, y, z, n, cellSize, pool);
+    return;
+  }
+
+  // every boid's cell in the grid as it is, the ones that changed listed
+  // per chunk with the cell they left, and how far past the bounds the
+  // boids outside them are, below in lo and above in hi
+  unsigned cells = numCells();
+  unsigned numChunks = (n + BUILD_GRAIN - 1) / BUILD_GRAIN;
+  m_chunkMoves.resize(numChunks);
+  std::vector<Bounds> overhangs(numChunks);
+  std::atomic<unsigned> outside(0);
+
+  pool.parallelFor(numChunks, 1, [&](unsigned begin, unsigned end) {
+    for (unsigned k = begin; k < end; k++) {
+      std::vector<Move> &moves = m_chunkMoves[k];
+      moves.clear();
+      Bounds &over = overhangs[k];
+      for (int a = 0; a < 3; a++)
+        over.lo[a] = over.hi[a] = 0;
+      unsigned out = 0;
+      unsigned last = std::min((k + 1) * BUILD_GRAIN, n);
+      for (unsigned i = k * BUILD_GRAIN; i < last; i++) {
+        unsigned c = 0;
+        if (std::isfinite(x[i]) && std::isfinite(y[i]) &&
+            std::isfinite(z[i])) {
+          float const p[3] = {x[i], y[i], z[i]};
+          int cell[3];
+          bool inside = true;
+          for (int a = 0; a < 3; a++) {
+            // cellCoord() without the clamp, truncating what is known
+            // not to be negative spares a call to floor
+            float t = (p[a] - m_min[a]) / m_cellSize;
+            if (t >= 0 && t < m_dim[a]) {
+              cell[a] = int(t);
+            } else {
+              cell[a] = cellCoord(p[a], a);
+              inside = false;
+              if (t < 0)
+                over.lo[a] = std::max(over.lo[a], m_min[a] - p[a]);
+              else
+                over.hi[a] = std::max(
+                    over.hi[a], p[a] - (m_min[a] + m_dim[a] * m_cellSize));
+            }
+          }
+          c = cellIndex(cell[0], cell[1], cell[2]);
+          out += !inside;
+        }
+        if (c != m_cellOf[i]) {
+          Move move = {i, m_cellOf[i], c};
+          moves.push_back(move);
+          m_cellOf[i] = c;
+        }
+      }
+      outside += out;
+    }
+  });
+
+  m_arrivals.clear();
+  for (std::vector<Move> const &moves : m_chunkMoves)
+    m_arrivals.insert(m_arrivals.end(), moves.begin(), moves.end());
+
+  // boids past the grid's bounds go in the edge cells like build() puts
+  // boids it can't fit, queries clamp the same way and still find them,
+  // but enough of them crowd those cells and the grid is fitted again
+  if (m_arrivals.size() > n / REBUILD_FRACTION ||
+      outside > n / OUTSIDE_FRACTION) {
+    build(x, y, z, n, cellSize, pool);
+    return;
+  }
+
+  // the edge cells' boxes grow by these to still hold their boids
+  m_overLo = m_overHi = Vec3f(0, 0, 0);
+  for (Bounds const &over : overhangs)
+    for (int a = 0; a < 3; a++) {
+      m_overLo[a] = std::max(m_overLo[a], over.lo[a]);
+      m_overHi[a] = std::max(m_overHi[a], over.hi[a]);
+    }
+
+  // new cell starts from the old counts and the moves, and which cells
+  // anyone left or entered
+  m_newCellStart.resize(cells + 1);
+  m_touched.assign(cells, 0);
+  for (unsigned c = 0; c < cells; c++)
+    m_newCellStart[c + 1] = m_cellStart[c + 1] - m_cellStart[c];
+  for (Move const &move : m_arrivals) {
+    m_newCellStart[move.from + 1]--;
+    m_newCellStart[move.to + 1]++;
+    m_touched[move.from] = m_touched[move.to] = 1;
+  }
+  m_newCellStart[0] = 0;
+  for (unsigned c = 0; c < cells; c++)
+    m_newCellStart[c + 1] += m_newCellStart[c];
+
+  // the moves by the cell left and by the cell entered, then index, in
+  // the order the cells' members are
+  m_departures = m_arrivals;
+  std::sort(m_departures.begin(), m_departures.end(),
+            [](Move const &a, Move const &b) {
+              return a.from != b.from ? a.from < b.from : a.boid < b.boid;
+            });
+  std::sort(m_arrivals.begin(), m_arrivals.end(),
+            [](Move const &a, Move const &b) {
+              return a.to != b.to ? a.to < b.to : a.boid < b.boid;
+            });
+
+  // each block of cells writes its own part of the new index array, the
+  // cells nobody left or entered copied, the others merged from the
+  // members that stayed and the arrivals so cells stay in index order
+  m_newIndices.resize(n);
+  unsigned numBlocks = (cells + SCAN_BLOCK - 1) / SCAN_BLOCK;
+  pool.parallelFor(numBlocks, 1, [&](unsigned begin, unsigned end) {
+    for (unsigned b = begin; b < end; b++) {
+      unsigned first = b * SCAN_BLOCK;
+      unsigned last = std::min(first + SCAN_BLOCK, cells);
+
+      auto departure = std::lower_bound(
+          m_departures.begin(), m_departures.end(), first,
+          [](Move const &move, unsigned c) { return move.from < c; });
+      auto arrival = std::lower_bound(
+          m_arrivals.begin(), m_arrivals.end(), first,
+          [](Move const &move, unsigned c) { return move.to < c; });
+
+      for (unsigned c = first; c < last; c++) {
+        unsigned out = m_newCellStart[c];
+        if (!m_touched[c]) {
+          std::copy(m_indices.begin() + m_cellStart[c],
+                    m_indices.begin() + m_cellStart[c + 1],
+                    m_newIndices.begin() + out);
+          continue;
+        }
+        for (unsigned k = m_cellStart[c]; k < m_cellStart[c + 1]; k++) {
+          unsigned i = m_indices[k];
+          if (departure != m_departures.end() && departure->from == c &&
+              departure->boid == i) {
+            ++departure;
+            continue;
+          }
+          for (; arrival != m_arrivals.end() && arrival->to == c &&
+                 arrival->boid < i;
+               ++arrival)
+            m_newIndices[out++] = arrival->boid;
+          m_newIndices[out++] = i;
+        }
+        for (; arrival != m_arrivals.end() && arrival->to == c; ++arrival)
+          m_newIndices[out++] = arrival->boid;
+      }
+    }
+  });
+
+  m_indices.swap(m_newIndices);
+  m_cellStart.swap(m_newCellStart);
+  m_migrated = m_arrivals.size();
+  m_rebuilt = false;
+}
@@ -0,0 +1,127 @@
+/**
+ * File:	StreamBuffer.cpp
+ */
+
+#include "StreamBuffer.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// keeps every region's offset aligned for any attribute type
+static GLsizeiptr const REGION_ALIGN = 256;
+
+StreamBuffer::StreamBuffer()
+    : m_id(0), m_orphan(false), m_regionSize(0), m_region(0), m_stalls(0),
+      m_reallocations(0) {
+  for (GLsync &f : m_fences)
+    f = nullptr;
+}
+
+StreamBuffer::~StreamBuffer() {
+  // GL objects need the context, destroy() is the one to call
+}
+
+void StreamBuffer::create() {
+  glGenBuffers(1, &m_id);
+
+  char const *mode = std::getenv("BOIDS_STREAM");
+  m_orphan = mode && std::strcmp(mode, "orphan") == 0;
+}
+
+void StreamBuffer::destroy() {
+  for (GLsync &f : m_fences) {
+    if (f)
+      glDeleteSync(f);
+    f = nullptr;
+  }
+  glDeleteBuffers(1, &m_id);
+  m_id = 0;
+  m_regionSize = 0;
+}
+
+void StreamBuffer::waitFor(unsigned region) {
+  GLsync &f = m_fences[region];
+  if (!f)
+    return;
+
+  GLenum status = glClientWaitSync(f, 0, 0);
+  if (status == GL_TIMEOUT_EXPIRED) {
+    m_stalls++;
+    do {
+      status = glClientWaitSync(f, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+    } while (status == GL_TIMEOUT_EXPIRED);
+  }
+
+  glDeleteSync(f);
+  f = nullptr;
+}
+
+void *StreamBuffer::mapOrphan(GLsizeiptr size) {
+  glBindBuffer(GL_ARRAY_BUFFER, m_id);
+  glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+  m_reallocations++;
+  m_region = 0;
+  m_regionSize = size;
+  return glMapBufferRange(GL_ARRAY_BUFFER, 0, size,
+                          GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+}
+
+void *StreamBuffer::map(GLsizeiptr size) {
+  if (size <= 0)
+    return nullptr;
+  if (m_orphan)
+    return mapOrphan(size);
+
+  glBindBuffer(GL_ARRAY_BUFFER, m_id);
+
+  if (size > m_regionSize) {
+    // grow with some slack so a slowly growing flock isn't a realloc a frame
+    m_regionSize = size + size / 4;
+    m_regionSize = (m_regionSize + REGION_ALIGN - 1) / REGION_ALIGN;
+    m_regionSize *= REGION_ALIGN;
+    glBufferData(GL_ARRAY_BUFFER, m_regionSize * REGIONS, nullptr,
+                 GL_STREAM_DRAW);
+    m_reallocations++;
+
+    // the old storage is gone, and with it anything its fences guarded
+    for (GLsync &f : m_fences) {
+      if (f)
+        glDeleteSync(f);
+      f = nullptr;
+    }
+    m_region = REGIONS - 1;
+  }
+
+  m_region = (m_region + 1) % REGIONS;
+  waitFor(m_region);
+
+  void *data = glMapBufferRange(
+      GL_ARRAY_BUFFER, m_regionSize * m_region, size,
+      GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT |
+          GL_MAP_INVALIDATE_RANGE_BIT);
+  if (data)
+    return data;
+
+  std::cerr << "glMapBufferRange failed, stream buffer falls back to "
+            << "orphaning" << std::endl;
+  m_orphan = true;
+  return mapOrphan(size);
+}
+
+GLintptr StreamBuffer::unmap() {
+  glBindBuffer(GL_ARRAY_BUFFER, m_id);
+  glUnmapBuffer(GL_ARRAY_BUFFER);
+  return m_regionSize * m_region;
+}
+
+void StreamBuffer::fence() {
+  if (m_orphan)
+    return;
+
+  // drawn again while paused, only the latest draw needs guarding
+  GLsync &f = m_fences[m_region];
+  if (f)
+    glDeleteSync(f);
+  f = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
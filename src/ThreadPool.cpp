@@ -0,0 +1,105 @@
+/**
+ * File:	ThreadPool.cpp
+ */
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+unsigned ThreadPool::defaultThreads() {
+  char const *env = std::getenv("BOIDS_THREADS");
+  if (env && std::atoi(env) > 0)
+    return std::atoi(env);
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+ThreadPool::ThreadPool(unsigned numThreads)
+    : m_generation(0), m_busy(0), m_quit(false), m_task(nullptr),
+      m_fn(nullptr), m_count(0), m_grain(1), m_next(0) {
+  start(std::max(1u, numThreads) - 1);
+}
+
+ThreadPool::~ThreadPool() { stop(); }
+
+void ThreadPool::resize(unsigned numThreads) {
+  numThreads = std::max(1u, numThreads);
+  if (numThreads == size())
+    return;
+  stop();
+  start(numThreads - 1);
+}
+
+void ThreadPool::start(unsigned numWorkers) {
+  m_quit = false;
+  for (unsigned i = 0; i < numWorkers; i++)
+    m_workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+}
+
+void ThreadPool::stop() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_quit = true;
+  }
+  m_wake.notify_all();
+  for (std::thread &t : m_workers)
+    t.join();
+  m_workers.clear();
+}
+
+void ThreadPool::run(unsigned count, unsigned grain, Task task,
+                     void const *fn) {
+  grain = std::max(1u, grain);
+
+  // not worth waking anyone
+  if (m_workers.empty() || count <= grain) {
+    if (count > 0)
+      task(fn, 0, count);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_task = task;
+    m_fn = fn;
+    m_count = count;
+    m_grain = grain;
+    m_next = 0;
+    m_busy = m_workers.size();
+    m_generation++;
+  }
+  m_wake.notify_all();
+
+  work();
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_done.wait(lock, [this] { return m_busy == 0; });
+}
+
+void ThreadPool::work() {
+  for (;;) {
+    unsigned begin = m_next.fetch_add(m_grain);
+    if (begin >= m_count)
+      return;
+    m_task(m_fn, begin, std::min(begin + m_grain, m_count));
+  }
+}
+
+void ThreadPool::workerLoop() {
+  unsigned long seen = 0;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_wake.wait(lock, [&] { return m_quit || m_generation != seen; });
+      if (m_quit)
+        return;
+      seen = m_generation;
+    }
+
+    work();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (--m_busy == 0)
+      m_done.notify_one();
+  }
+}
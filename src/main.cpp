@@ -37,11 +37,21 @@
 #include "Mat4f.h"
 #include "OpenGLMatrixTools.h"
 #include "Camera.h"
+#include "Simulation.h"
+#include "FlockKernel.h"
+#include "Frustum.h"
+#include "Renderer.h"
+#include "StreamBuffer.h"
 
 #include <iostream>
 #include <fstream>
 #include <string>
 #include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
 using namespace std;
 
 //==================== GLOBAL VARIABLES ====================//
@@ -52,15 +62,77 @@ using namespace std;
 // Drawing Program
 GLuint basicProgramID;
 
-// Data needed for Quad
+// Binds, and the transform and colours every program reads
+Renderer renderer;
+
+// Uniform locations, looked up once the programs are linked
+GLint basic_drawHeading;
+GLint inst_drawHeading;
+GLint geom_viewport;
+
+// Data needed for Quad, rewritten every frame
 GLuint vaoID;
-GLuint vertBufferID;
+StreamBuffer quadStream;
 Mat4f M;
 
 // Data needed for Line
 GLuint line_vaoID;
-GLuint line_vertBufferID;
-Mat4f line_M;
+StreamBuffer lineStream;
+
+// How the flock is drawn, 'i' cycles through them.
+// Instanced: a glyph and a heading line mesh drawn once per boid, with the
+// flock's position, heading and type arrays uploaded as they are.
+// Geometry: the same arrays drawn as one point per boid, a geometry shader
+// emits the glyph and the heading line, all in one draw.
+// Cpu: every vertex built on the CPU.
+enum RenderMode { RENDER_INSTANCED, RENDER_GEOMETRY, RENDER_CPU, RENDER_MODES };
+RenderMode g_renderMode = RENDER_INSTANCED;
+GLuint instancedProgramID;
+GLuint inst_vaoID;
+GLuint meshBufferID; // the glyph at unit width, then the heading line
+StreamBuffer instanceStream; // the flock's arrays, for both modes above
+GLuint flockBufferID; // or all of them, resident, see updateFlockBuffer()
+unsigned flockBufferBoids = 0; // what flockBufferID is sized for
+unsigned long flockBufferLayout = 0; // BoidSystem::layout() of its types
+unsigned g_flockRewritten = 0; // boids updateFlockBuffer() last rewrote
+GLuint geometryProgramID;
+GLuint point_vaoID;
+
+// Frustum culling: only the boids in grid cells the camera can see are
+// uploaded and drawn, 'c' turns it off. Without a grid, all of them are.
+bool g_cull = true;
+bool g_drawAll = true;       // every boid, in index order
+std::vector<unsigned> g_drawn; // else the boids to draw
+unsigned g_drawCount = 0;
+bool g_reloadBoids = false;  // the view moved, what is visible may have too
+
+// how far a boid's glyph and heading line reach from its position
+float const CULL_MARGIN = 7 * 1.5 + 5;
+
+// Level of detail by distance from the camera, a grid cell at a time, 'l'
+// turns it off. Cells nearer than g_lodNear draw every boid's glyph as the
+// render mode does, up to g_lodFar a sprite per boid, beyond that a single
+// splat per cell, sized by how many boids it holds. BOIDS_LOD=near,far
+// sets the distances.
+struct Sprite {
+  float x, y, z;
+  float size; // world units
+};
+bool g_lod = true;
+float g_lodNear = 600;
+float g_lodFar = 900;
+std::vector<Sprite> g_sprites; // a boid each
+std::vector<Sprite> g_splats;  // a cell each
+unsigned g_splattedBoids = 0;
+GLuint spriteProgramID;
+GLuint sprite_vaoID;
+StreamBuffer spriteStream; // the sprites, then the splats
+GLint sprite_pixelsPerUnit;
+
+// Data needed for Walls, uploaded once since they never move
+GLuint wall_vaoID;
+GLuint wall_vertBufferID;
+unsigned wallVertCount = 0;
 
 // Only one camera so only one veiw and perspective matrix are needed.
 Mat4f V;
@@ -91,11 +163,13 @@ float WIN_FOV = 60;
 float WIN_NEAR = 0.01;
 float WIN_FAR = 1000;
 
-Vec3f place = Vec3f(0,0,0);
-float pi = 3.1459265359;
-int border, fov, fol;
 
-bool followMouse = false;
+// The flock, stepped while playing. BOIDS_THREADS sets how many threads
+Simulation sim;
+
+// Boids per chunk when the vertex loops run on sim's pool, each chunk
+// writes its own part of the mapped buffer
+unsigned const VERTEX_GRAIN = 4096;
 
 //==================== FUNCTION DECLARATIONS ====================//
 void displayFunc();
@@ -105,6 +179,15 @@ void generateIDs();
 void deleteIDs();
 void setupVAO();
 void loadQuadGeometryToGPU();
+void loadLineGeometryToGPU();
+void loadInstancesToGPU();
+void updateFlockBuffer();
+void pointInstanceAttributes(GLintptr offset, unsigned n);
+void loadSpritesToGPU();
+void loadBoidsToGPU();
+void cullBoids();
+char const *renderModeName(RenderMode mode);
+void fenceStreams();
 void reloadProjectionMatrix();
 void loadModelViewMatrix();
 void setupModelViewProjectionTransform();
@@ -120,241 +203,253 @@ void windowMouseButtonFunc(GLFWwindow *window, int button, int action,
 void windowMouseMotionFunc(GLFWwindow *window, double x, double y);
 void windowKeyFunc(GLFWwindow *window, int key, int scancode, int action,
                    int mods);
-void animateQuad(float t);
+void updateWindowTitle(GLFWwindow *window);
 void moveCamera();
-void reloadMVPUniform();
-void reloadColorUniform(float r, float g, float b);
+void reloadViewportUniform();
 std::string GL_ERROR();
 int main(int, char **);
 
 //==================== FUNCTION DEFINITIONS ====================//
 
-struct Boid {
-  Vec3f position;
-  Vec3f velocity;
-  Vec3f heading;
-  Vec3f v;
-  bool predator;
-  bool wall;
-};
-
-std::vector<Boid> boids;
+void displayFunc() {
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-void setupBoids(unsigned int numBoids, unsigned int numPreds) {
-  float x, y, z;
-  int dist = 100;
-  int distbtwn = dist/2;
-  for (unsigned i = 0; i < numBoids; i++) {
-    Boid b;
-    x = (rand()%20)-10;
-    y = (rand()%20)-10;
-    z = (rand()%20)-10;
-
-    b.position = Vec3f(rand()%dist-distbtwn, rand()%dist-distbtwn, rand()%dist-distbtwn);
-    b.v = Vec3f(0, 0, 0);
-    b.velocity = Vec3f(x,y,z);
-    b.predator = false;
-    b.wall = false;
-
-    boids.push_back(b);
-  }
+  unsigned numBoids = g_drawCount;
 
-  for (unsigned i = 0; i < numPreds; i++) {
-    Boid b;
-    x = (rand()%20)-10;
-    y = (rand()%20)-10;
-    z = (rand()%20)-10;
+  // MVP and colours are already in the Frame buffer, see Renderer.h
 
-    b.position = Vec3f(rand()%dist-distbtwn, rand()%dist-distbtwn, rand()%dist-distbtwn);
-    b.velocity = Vec3f(x, y, z);
-    b.v = Vec3f(0,0,0);
-    b.predator = true;
-    b.wall = false;
+  // walls share the boids' transform and colour
+  renderer.useProgram(basicProgramID);
+  glUniform1i(basic_drawHeading, 0);
+  renderer.bindVertexArray(wall_vaoID);
+  glDrawArrays(GL_TRIANGLES, 0, wallVertCount);
 
-    boids.push_back(b);
+  // the boids too far for a glyph, whatever the render mode
+  unsigned numSprites = g_sprites.size() + g_splats.size();
+  if (numSprites) {
+    renderer.useProgram(spriteProgramID);
+    renderer.bindVertexArray(sprite_vaoID);
+    glDrawArrays(GL_POINTS, 0, numSprites);
   }
 
-  for (signed i = -50; i < 50; i++) {
-    Boid b;
+  if (g_renderMode == RENDER_INSTANCED) {
+    renderer.useProgram(instancedProgramID);
 
-    b.position = Vec3f(-border/2, i*10, -border/2);
-    b.velocity = Vec3f(0, 0, 0);
-    b.predator = false;
-    b.wall = true;
+    // glyph is vertices 0-8 of the mesh, the line 9-10
+    renderer.bindVertexArray(inst_vaoID);
+    glUniform1i(inst_drawHeading, 0);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 9, numBoids);
 
-    boids.push_back(b);
+    glUniform1i(inst_drawHeading, 1);
+    glDrawArraysInstanced(GL_LINES, 9, 2, numBoids);
+    return;
   }
-}
-
-void displayFunc() {
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-  // Use our shader
-  glUseProgram(basicProgramID);
-
-  // ===== DRAW QUAD ====== //
-  MVP = P * V * M;
-  reloadMVPUniform();
-  reloadColorUniform(1, 0, 1);
+  if (g_renderMode == RENDER_GEOMETRY) {
+    renderer.useProgram(geometryProgramID);
+    renderer.bindVertexArray(point_vaoID);
+    glDrawArrays(GL_POINTS, 0, numBoids);
+    return;
+  }
 
   // Use VAO that holds buffer bindings
   // and attribute config of buffers
-  glBindVertexArray(vaoID);
+  renderer.useProgram(basicProgramID);
+  renderer.bindVertexArray(vaoID);
   // Draw Quads, start at vertex 0, draw 4 of them (for a quad)
-  glDrawArrays(GL_TRIANGLES, 0, 9*boids.size());
+  glDrawArrays(GL_TRIANGLES, 0, 9*numBoids);
 
   // ==== DRAW LINE ===== //
-  MVP = P * V * line_M;
-  reloadMVPUniform();
-
-  reloadColorUniform(0, 1, 1);
+  glUniform1i(basic_drawHeading, 1);
 
   // Use VAO that holds buffer bindings
   // and attribute config of buffers
-  glBindVertexArray(line_vaoID);
+  renderer.bindVertexArray(line_vaoID);
   // Draw lines
-  glDrawArrays(GL_LINES, 0, 2*boids.size());
+  glDrawArrays(GL_LINES, 0, 2*numBoids);
 
 }
 
-float length(Vec3f A, Vec3f B) {
-  float x = A.x() - B.x();
-  float y = A.y() - B.y();
-  float z = A.z() - B.z();
+// Overlay of the flock stats and what the last loadBoidsToGPU() drew.
+// Called after every reload; the flock and stream parts change every step
+// and are refreshed a few times a second, the draw counts every time so
+// they follow the camera while paused too.
+void updateWindowTitle(GLFWwindow *window) {
+  static unsigned frame = 0;
+  static std::string flock, streaming;
+  if (frame++ % 30 == 0) {
+    FlockStats const &stats = sim.stats();
+    Vec3f c = stats.centroid;
+    Vec3f extent = stats.boundsMax - stats.boundsMin;
+    std::ostringstream out;
+    out.precision(0);
+    out << std::fixed << stats.typeCount[BoidSystem::PREY] << " prey, "
+        << stats.typeCount[BoidSystem::PREDATOR] << " predators, centroid ("
+        << c.x() << ", " << c.y() << ", " << c.z() << "), extent "
+        << extent.x() << " x " << extent.y() << " x " << extent.z()
+        << ", speed " << std::setprecision(2) << stats.meanVelocity.length();
+    flock = out.str();
+
+    StreamBuffer const &stream =
+        g_renderMode == RENDER_CPU ? quadStream : instanceStream;
+    out.str("");
+    out << ", stream " << (stream.orphaning() ? "orphaned" : "ring")
+        << " stalls " << stream.stalls() << " reallocs "
+        << stream.reallocations() << ", resident rewrote "
+        << g_flockRewritten;
+    if (SpatialGrid const *grid = sim.grid()) {
+      if (grid->rebuilt())
+        out << ", grid built";
+      else
+        out << ", grid moved " << grid->migrated();
+    }
+    streaming = out.str();
+  }
 
-  return sqrt(x*x + y*y + z*z);
+  // vertices each glyph costs, the geometry shader's are the ones it emits
+  unsigned glyphVerts = g_renderMode == RENDER_GEOMETRY ? 13 : 11;
+  unsigned n = sim.boids().size();
+  unsigned drawn = g_drawCount + g_sprites.size() + g_splattedBoids;
+  std::ostringstream title;
+  title << "CPSC 587 A4 - " << flock << ", glyphs " << g_drawCount << " ("
+        << g_drawCount * glyphVerts << " verts), sprites " << g_sprites.size()
+        << ", splats " << g_splats.size() << " of " << g_splattedBoids
+        << ", culled " << n - drawn << streaming;
+  glfwSetWindowTitle(window, title.str().c_str());
 }
 
-float vecToScal(Vec3f a) {
-  float x = a.x();
-  float y = a.y();
-  float z = a.z();
-
-  return sqrt(x*x + y*y + z*z);
+// Three triangles at p, the glyph every boid and wall post is drawn with.
+// Writes 9 vertices to v, returns the end.
+Vec3f *writeGlyph(Vec3f *v, float x, float y, float z, float width) {
+  *v++ = Vec3f(0.5*width+x, 1.5*width+y, 0*width+z);
+  *v++ = Vec3f(0.5*width+x, 0.5*width+y, 0.5*width+z);
+  *v++ = Vec3f(0*width+x, 0*width+y, 0*width+z);
+
+  *v++ = Vec3f(0*width+x, 0*width+y, 0*width+z);
+  *v++ = Vec3f(0.5*width+x, 0.5*width+y, 0.5*width+z);
+  *v++ = Vec3f(1*width+x, 0*width+y, 0*width+z);
+
+  *v++ = Vec3f(1*width+x, 0*width+y, 0*width+z);
+  *v++ = Vec3f(0.5*width+x, 0.5*width+y, 0.5*width+z);
+  *v++ = Vec3f(0.5*width+x, 1.5*width+y, 0*width+z);
+  return v;
 }
 
-void boundaries(Vec3f p, int i) {
-  float turn = 0.05;
-
-  if (p.x() >= border)
-    boids[i].velocity.x() += -turn;
-  else if (p.x() < -border)
-    boids[i].velocity.x() += turn;
-
-  if (p.y() >= border)
-    boids[i].velocity.y()  += -turn;
-  else if (p.y() < -border)
-    boids[i].velocity.y() += turn;
-
-  if (p.z() >= border)
-    boids[i].velocity.z() += -turn;
-  else if (p.z() < -border)
-    boids[i].velocity.z() += turn;
-
+// Whatever the current render mode draws the flock from
+void loadBoidsToGPU() {
+  cullBoids();
+  loadSpritesToGPU();
+  if (g_renderMode == RENDER_CPU) {
+    loadQuadGeometryToGPU();
+    loadLineGeometryToGPU();
+  } else {
+    loadInstancesToGPU();
+  }
 }
 
-bool viewRange(int i, int j) {
-  float phi = fov/2 * pi/180;
-
-  Vec3f qmp = (boids[j].position - boids[i].position)/length(boids[j].position, boids[i].position);
-  float hqp = vecToScal(boids[i].heading/vecToScal(boids[i].heading))*vecToScal(qmp)*cos(phi);
-
-
-  if (hqp > cos(phi)) {
-    //printf("seen\n");
-    return true;
+// Guards what this frame drew from, once the draws are issued
+void fenceStreams() {
+  spriteStream.fence();
+  if (g_renderMode == RENDER_CPU) {
+    quadStream.fence();
+    lineStream.fence();
+  } else {
+    instanceStream.fence();
   }
-
-  return false;
 }
 
+// Picks the boids to draw, and how, whole cells of the simulation's grid at
+// a time
+void cullBoids() {
+  BoidSystem const &boids = sim.boids();
+  SpatialGrid const *grid = sim.grid();
+
+  g_drawn.clear();
+  g_sprites.clear();
+  g_splats.clear();
+  g_splattedBoids = 0;
+  g_drawAll = !(g_cull || g_lod) || !grid;
+  if (g_drawAll) {
+    g_drawCount = boids.size();
+    return;
+  }
 
-// make them be pulled into centre by a "force" when exit boundaries
-void animateQuad(float t) {
-  Vec3f avgVelocity, avgPos, avoVector, turnVector, mostDense, avgHeading;
-  Vec3f direct;
-  float distance = 0;
-  float preyMaxSpeed = 1;
-  float predMaxSpeed = 3;
-  float speed = 0;
-  int numNeighbours = 0;
-  float avo = 15;
-  //float fol = 100;
-  bool seen = false;
-
-  for (unsigned i = 0; i < boids.size(); i++) {
-    avgPos = avgVelocity = avoVector = mostDense = Vec3f(0,0,0);
-
-    for (unsigned j = 0; j < boids.size(); j++) {
-      if (j != i) {
-        mostDense += boids[j].position;
-        distance = length(boids[j].position, boids[i].position);
-        seen = viewRange(i, j);
-        // if close enough, follow
-        if (distance < fol && distance > avo && seen && !boids[j].predator && !boids[j].wall) {
-          numNeighbours++;
-          // calculate average position
-          avgPos += boids[j].position;
-          // follow, velocity matching
-          avgVelocity += boids[j].velocity;
-        }
-        // avoid predator, predator is 10 time scarier than colliding w/ prey
-        if (distance < avo * 10 && boids[j].predator && !boids[j].wall) {
-          avoVector -= (boids[j].position - boids[i].position) / 25;
-        }
-        if (distance < avo && boids[j].wall) {
-          avoVector -= (boids[j].position - boids[i].position)/10 ;
-        }
-        // avoid colliding into prey
-        if (seen && distance < avo && !boids[j].predator && !boids[j].wall) {
-          avoVector -= (boids[j].position - boids[i].position) / 50;
-        }
+  Frustum frustum; // everything visible, unless culling
+  if (g_cull)
+    frustum = Frustum(MVP); // M is identity, so this is world space
+  auto classify = [&](Vec3f const &lo, Vec3f const &hi) {
+    return int(frustum.classify(lo, hi));
+  };
+
+  if (!g_lod) {
+    grid->forEachSpanIn(classify, CULL_MARGIN,
+                        [&](unsigned const *indices, unsigned count) {
+                          g_drawn.insert(g_drawn.end(), indices,
+                                         indices + count);
+                        });
+  } else {
+    Vec3f eye = camera.position();
+    float near2 = g_lodNear * g_lodNear;
+    float far2 = g_lodFar * g_lodFar;
+    float const *px = boids.x();
+    float const *py = boids.y();
+    float const *pz = boids.z();
+
+    grid->forEachCellIn(classify, CULL_MARGIN, [&](Vec3f const &lo,
+                                                   Vec3f const &hi,
+                                                   unsigned const *indices,
+                                                   unsigned count) {
+      // from the nearest point of the cell, a boid in it is never nearer
+      float d2 = 0;
+      for (int a = 0; a < 3; a++) {
+        float d = std::max(std::max(lo[a] - eye[a], eye[a] - hi[a]), 0.f);
+        d2 += d * d;
       }
-    } // end loop for j
-
-    // have predators follow prey
-    mostDense = ((mostDense/(boids.size()-1))-boids[i].position) / 200;
 
-    // following mouse behaviour
-    if (followMouse)
-      direct = (place - boids[i].position) / 1000;  // directed by mouse movement
-    else
-      direct = Vec3f(0,0,0);
-
-    // found another behaviour
-    if (numNeighbours > 0) {
-      avgPos = ((avgPos/numNeighbours)-boids[i].position) / 150;
-      avgVelocity = ((avgVelocity/numNeighbours)-boids[i].velocity) / 8;
+      if (d2 < near2) {
+        g_drawn.insert(g_drawn.end(), indices, indices + count);
+      } else if (d2 < far2) {
+        for (unsigned k = 0; k < count; k++) {
+          unsigned i = indices[k];
+          float width = boids.isPredator(i) ? 7 : 2; // as the glyph
+          g_sprites.push_back(Sprite{px[i], py[i], pz[i], width});
+        }
+      } else {
+        Vec3f sum;
+        for (unsigned k = 0; k < count; k++)
+          sum += Vec3f(px[indices[k]], py[indices[k]], pz[indices[k]]);
+        Vec3f c = sum / float(count);
+        // as wide as the cell's prey packed together, at most the cell
+        float size = std::min(2 * std::cbrt(float(count)), grid->cellSize());
+        g_splats.push_back(Sprite{c.x(), c.y(), c.z(), size});
+        g_splattedBoids += count;
+      }
+    });
+  }
 
-      avgHeading = (avgHeading/numNeighbours)-boids[i].heading;
+  // all near and in view, the arrays can be copied as they are
+  g_drawAll = g_drawn.size() == boids.size();
+  g_drawCount = g_drawAll ? boids.size() : g_drawn.size();
+}
 
-      numNeighbours = 0;  // reset for next boid
-    }
-    boids[i].velocity += avgPos + avgVelocity + avoVector + direct;
-    if (boids[i].predator)
-      boids[i].velocity += avoVector + avgPos;
-    // stay within boundaries
-    boundaries(boids[i].position, i);
-
-    // limit speed
-    speed = vecToScal(boids[i].velocity);
-    if (speed > preyMaxSpeed && !boids[i].predator && !boids[i].wall)
-      boids[i].velocity = ((boids[i].velocity / speed) * preyMaxSpeed);
-    else if (speed > predMaxSpeed && boids[i].predator && !boids[i].wall)
-      boids[i].velocity = ((boids[i].velocity / speed) * predMaxSpeed);
-
-    boids[i].v = boids[i].v + boids[i].velocity;
-    // update movement, but not the walls
-    if (!boids[i].wall)
-      boids[i].position += boids[i].velocity;
-  } // end loop for i
+char const *renderModeName(RenderMode mode) {
+  switch (mode) {
+  case RENDER_INSTANCED:
+    return "instanced";
+  case RENDER_GEOMETRY:
+    return "geometry shader";
+  default:
+    return "cpu vertices";
+  }
 }
 
 void loadQuadGeometryToGPU() {
   // Just basic layout of floats, for a quad
   // 3 floats per vertex, 4 vertices
-  float width = 2;
-  std::vector<Vec3f> verts;
+  BoidSystem const &boids = sim.boids();
+  Vec3f *verts = (Vec3f *)quadStream.map(sizeof(Vec3f) * 9 * g_drawCount);
+  if (!verts)
+    return;
 /*
   verts.push_back(Vec3f(0*width+x, 1*width+y, 0*width+z));
   verts.push_back(Vec3f(1*width+x, 1*width+y, 0*width+z));
@@ -365,99 +460,225 @@ void loadQuadGeometryToGPU() {
   verts.push_back(Vec3f(0*width+x, 0*width+y, 0*width+z));
 */
 
-  for (unsigned i = 0; i < boids.size(); i++) {
-    if (boids[i].wall)
-      width = 15;
-    else if (boids[i].predator)
-      width = 7;
-    else
-      width = 2;
-    float x = boids[i].position.x();
-    float y = boids[i].position.y();
-    float z = boids[i].position.z();
-
-    verts.push_back(Vec3f(0.5*width+x, 1.5*width+y, 0*width+z));
-    verts.push_back(Vec3f(0.5*width+x, 0.5*width+y, 0.5*width+z));
-    verts.push_back(Vec3f(0*width+x, 0*width+y, 0*width+z));
-
-    verts.push_back(Vec3f(0*width+x, 0*width+y, 0*width+z));
-    verts.push_back(Vec3f(0.5*width+x, 0.5*width+y, 0.5*width+z));
-    verts.push_back(Vec3f(1*width+x, 0*width+y, 0*width+z));
-
-    verts.push_back(Vec3f(1*width+x, 0*width+y, 0*width+z));
-    verts.push_back(Vec3f(0.5*width+x, 0.5*width+y, 0.5*width+z));
-    verts.push_back(Vec3f(0.5*width+x, 1.5*width+y, 0*width+z));
-  }
-
+  float const *px = boids.x();
+  float const *py = boids.y();
+  float const *pz = boids.z();
+
+  sim.pool().parallelFor(g_drawCount, VERTEX_GRAIN, [&](unsigned begin,
+                                                        unsigned end) {
+    Vec3f *v = verts + 9 * begin;
+    for (unsigned k = begin; k < end; k++) {
+      unsigned i = g_drawAll ? k : g_drawn[k];
+      float width = boids.isPredator(i) ? 7 : 2;
+      v = writeGlyph(v, px[i], py[i], pz[i], width);
+    }
+  });
 
-  glBindBuffer(GL_ARRAY_BUFFER, vertBufferID);
-  glBufferData(GL_ARRAY_BUFFER,
-               sizeof(Vec3f) * 9 * boids.size(), // byte size of Vec3f, 4 of them
-               verts.data(),      // pointer (Vec3f*) to contents of verts
-               GL_STATIC_DRAW);   // Usage pattern of GPU buffer
+  // this frame's vertices sit at a different offset of the ring every time
+  GLintptr offset = quadStream.unmap();
+  renderer.bindVertexArray(vaoID);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void *)offset);
 }
 
 void loadLineGeometryToGPU() {
   float length = 5;
-  // Just basic layout of floats, for a quad
-  // 3 floats per vertex, 4 vertices
-  Vec3f h;
-  std::vector<Vec3f> verts;
+  BoidSystem const &boids = sim.boids();
+  Vec3f *verts = (Vec3f *)lineStream.map(sizeof(Vec3f) * 2 * g_drawCount);
+  if (!verts)
+    return;
+
+  sim.pool().parallelFor(g_drawCount, VERTEX_GRAIN, [&](unsigned begin,
+                                                        unsigned end) {
+    Vec3f *v = verts + 2 * begin;
+    for (unsigned k = begin; k < end; k++) {
+      unsigned i = g_drawAll ? k : g_drawn[k];
+      Vec3f p = boids.position(i);
+      Vec3f h = boids.heading(i) * length;
+
+      *v++ = p;
+      *v++ = p + h;
+    }
+  });
 
-  for (unsigned i = 0; i < boids.size(); i++) {
+  GLintptr offset = lineStream.unmap();
+  renderer.bindVertexArray(line_vaoID);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void *)offset);
+}
 
-    float x = boids[i].position.x();
-    float y = boids[i].position.y();
-    float z = boids[i].position.z();
-    h = (boids[i].velocity / vecToScal(boids[i].velocity))*length;
-    boids[i].heading = h;
+// Only called from init(), the glyph and heading line every instance draws
+void loadMeshToGPU() {
+  std::vector<Vec3f> verts(11);
+  writeGlyph(verts.data(), 0, 0, 0, 1);
+  verts[9] = Vec3f(0, 0, 0);
+  verts[10] = Vec3f(1, 0, 0);
 
-    if (!boids[i].wall) {
-      verts.push_back(Vec3f(x,y,z));
-      verts.push_back(Vec3f(h.x()+x,h.y()+y,h.z()+z));
-    }
-    else {
-      verts.push_back(Vec3f(0,0,0));
-      verts.push_back(Vec3f(0,0,0));
-    }
+  glBindBuffer(GL_ARRAY_BUFFER, meshBufferID);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(Vec3f) * verts.size(), verts.data(),
+               GL_STATIC_DRAW);
+}
+
+// The flock arrays as they are, no vertex is built on the CPU. Instanced,
+// every array is read once per instance, as points once per vertex.
+// Drawing every boid they come straight from the resident flock buffer,
+// a subset is gathered into the instance stream.
+void loadInstancesToGPU() {
+  if (g_drawAll) {
+    updateFlockBuffer();
+    glBindBuffer(GL_ARRAY_BUFFER, flockBufferID);
+    pointInstanceAttributes(0, sim.boids().size());
+    return;
+  }
 
+  BoidSystem const &boids = sim.boids();
+  unsigned n = g_drawCount;
+
+  // x, y, z, hx, hy, hz as floats, then the type bytes
+  char *data = (char *)instanceStream.map((sizeof(float) * 6 + 1) * n);
+  if (!data)
+    return;
+
+  float const *sections[6] = {boids.x(),  boids.y(),  boids.z(),
+                              boids.hx(), boids.hy(), boids.hz()};
+  float *out = (float *)data;
+  unsigned char *types = (unsigned char *)(data + sizeof(float) * 6 * n);
+  // gathered a section at a time, each read stays in one array
+  sim.pool().parallelFor(n, VERTEX_GRAIN, [&](unsigned begin, unsigned end) {
+    for (unsigned a = 0; a < 6; a++)
+      for (unsigned k = begin; k < end; k++)
+        out[a * n + k] = sections[a][g_drawn[k]];
+    for (unsigned k = begin; k < end; k++)
+      types[k] = boids.types()[g_drawn[k]];
+  });
+
+  GLintptr offset = instanceStream.unmap();
+  pointInstanceAttributes(offset, n);
+}
 
+// Rewrites the boids the simulation changed since the last call, a dirty
+// range at a time. The type bytes only change with the flock or its
+// order, they are written when the buffer is sized or the boids permuted.
+void updateFlockBuffer() {
+  BoidSystem const &boids = sim.boids();
+  DirtyRanges &changed = sim.changed();
+  unsigned n = boids.size();
+
+  glBindBuffer(GL_ARRAY_BUFFER, flockBufferID);
+  if (n != flockBufferBoids) {
+    // laid out as the instance stream, so the same attributes read both
+    glBufferData(GL_ARRAY_BUFFER, (sizeof(float) * 6 + 1) * n, nullptr,
+                 GL_DYNAMIC_DRAW);
+    flockBufferBoids = n;
+    flockBufferLayout = boids.layout() - 1;
+    changed.clear();
+    changed.add(0, n);
+  }
+  if (boids.layout() != flockBufferLayout) {
+    glBufferSubData(GL_ARRAY_BUFFER, sizeof(float) * 6 * n, n,
+                    boids.types());
+    flockBufferLayout = boids.layout();
   }
 
-  glBindBuffer(GL_ARRAY_BUFFER, line_vertBufferID);
-  glBufferData(GL_ARRAY_BUFFER,
-               sizeof(Vec3f) * 2 * boids.size(), // byte size of Vec3f, 4 of them
-               verts.data(),      // pointer (Vec3f*) to contents of verts
-               GL_STATIC_DRAW);   // Usage pattern of GPU buffer
+  float const *sections[6] = {boids.x(),  boids.y(),  boids.z(),
+                              boids.hx(), boids.hy(), boids.hz()};
+  for (DirtyRanges::Range const &r : changed.ranges())
+    for (unsigned a = 0; a < 6; a++)
+      glBufferSubData(GL_ARRAY_BUFFER, sizeof(float) * (a * n + r.begin),
+                      sizeof(float) * (r.end - r.begin),
+                      sections[a] + r.begin);
 
+  g_flockRewritten = changed.count();
+  changed.clear();
 }
 
-void setupVAO() {
-  glBindVertexArray(vaoID);
+// Points the per boid attributes at n boids' sections from offset in the
+// bound GL_ARRAY_BUFFER, locations 1-7 after the mesh when instanced, 0-6
+// as points
+void pointInstanceAttributes(GLintptr offset, unsigned n) {
+  bool instanced = g_renderMode == RENDER_INSTANCED;
+  GLuint first = instanced ? 1 : 0;
+  renderer.bindVertexArray(instanced ? inst_vaoID : point_vaoID);
+  for (GLuint a = 0; a < 6; a++) {
+    glEnableVertexAttribArray(first + a);
+    glVertexAttribPointer(first + a, 1, GL_FLOAT, GL_FALSE, 0,
+                          (void *)(offset + sizeof(float) * a * n));
+    glVertexAttribDivisor(first + a, instanced ? 1 : 0);
+  }
+  glEnableVertexAttribArray(first + 6);
+  glVertexAttribPointer(first + 6, 1, GL_UNSIGNED_BYTE, GL_FALSE, 0,
+                        (void *)(offset + sizeof(float) * 6 * n));
+  glVertexAttribDivisor(first + 6, instanced ? 1 : 0);
+}
+
+// The sprites and splats cullBoids picked, drawn as points
+void loadSpritesToGPU() {
+  unsigned n = g_sprites.size() + g_splats.size();
+  Sprite *out = (Sprite *)spriteStream.map(sizeof(Sprite) * n);
+  if (!out)
+    return;
+
+  memcpy(out, g_sprites.data(), sizeof(Sprite) * g_sprites.size());
+  memcpy(out + g_sprites.size(), g_splats.data(),
+         sizeof(Sprite) * g_splats.size());
+
+  GLintptr offset = spriteStream.unmap();
+  renderer.bindVertexArray(sprite_vaoID);
+  glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, (void *)offset);
+}
 
+// Only called from init(), the walls never move
+void loadWallGeometryToGPU() {
+  float width = 15;
+  std::vector<Vec3f> verts;
+
+  Obstacles const &obstacles = sim.obstacles();
+  for (unsigned i = 0; i < obstacles.size(); i++) {
+    Obstacles::Segment const &s = obstacles.segment(i);
+    Vec3f dir = s.b - s.a;
+    int posts = int(dir.length() / Simulation::WALL_SPACING) + 1;
+    if (posts > 1)
+      dir /= posts - 1;
+
+    for (int k = 0; k < posts; k++) {
+      Vec3f p = s.a + dir * k;
+      verts.resize(verts.size() + 9);
+      writeGlyph(&verts[verts.size() - 9], p.x(), p.y(), p.z(), width);
+    }
+  }
+  wallVertCount = verts.size();
+
+  glBindBuffer(GL_ARRAY_BUFFER, wall_vertBufferID);
+  glBufferData(GL_ARRAY_BUFFER,
+               sizeof(Vec3f) * verts.size(),
+               verts.data(),
+               GL_STATIC_DRAW);
+}
+
+// The boid VAOs get their attribute pointers every frame, when the
+// streams hand out this frame's offset
+void setupVAO() {
+  renderer.bindVertexArray(vaoID);
   glEnableVertexAttribArray(0); // match layout # in shader
-  glBindBuffer(GL_ARRAY_BUFFER, vertBufferID);
-  glVertexAttribPointer(0,        // attribute layout # above
-                        3,        // # of components (ie XYZ )
-                        GL_FLOAT, // type of components
-                        GL_FALSE, // need to be normalized?
-                        0,        // stride
-                        (void *)0 // array buffer offset
-                        );
 
-  glBindVertexArray(line_vaoID);
+  renderer.bindVertexArray(line_vaoID);
+  glEnableVertexAttribArray(0);
+
+  renderer.bindVertexArray(sprite_vaoID);
+  glEnableVertexAttribArray(0);
+
+  renderer.bindVertexArray(wall_vaoID);
 
   glEnableVertexAttribArray(0); // match layout # in shader
-  glBindBuffer(GL_ARRAY_BUFFER, line_vertBufferID);
-  glVertexAttribPointer(0,        // attribute layout # above
-                        3,        // # of components (ie XYZ )
-                        GL_FLOAT, // type of components
-                        GL_FALSE, // need to be normalized?
-                        0,        // stride
-                        (void *)0 // array buffer offset
-                        );
-
-  glBindVertexArray(0); // reset to default
+  glBindBuffer(GL_ARRAY_BUFFER, wall_vertBufferID);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void *)0);
+
+  // the per boid attributes are pointed at the instance stream every frame
+  renderer.bindVertexArray(inst_vaoID);
+
+  glEnableVertexAttribArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, meshBufferID);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void *)0);
+
+  renderer.bindVertexArray(0); // reset to default
 }
 
 void reloadProjectionMatrix() {
@@ -477,7 +698,6 @@ void reloadProjectionMatrix() {
 
 void loadModelViewMatrix() {
   M = IdentityMatrix();
-  line_M = IdentityMatrix();
   // view doesn't change, but if it did you would use this
   V = camera.lookatMatrix();
 }
@@ -486,25 +706,19 @@ void reloadViewMatrix() { V = camera.lookatMatrix(); }
 
 void setupModelViewProjectionTransform() {
   MVP = P * V * M; // transforms vertices from right to left (odd huh?)
+  renderer.setMVP(MVP);
+  g_reloadBoids = g_cull || g_lod;
 }
 
-void reloadMVPUniform() {
-  GLint id = glGetUniformLocation(basicProgramID, "MVP");
-
-  glUseProgram(basicProgramID);
-  glUniformMatrix4fv(id,        // ID
-                     1,         // only 1 matrix
-                     GL_TRUE,   // transpose matrix, Mat4f is row major
-                     MVP.data() // pointer to data in Mat4f
-                     );
-}
-
-void reloadColorUniform(float r, float g, float b) {
-  GLint id = glGetUniformLocation(basicProgramID, "inputColor");
+// The geometry shader sizes heading lines in pixels, sprites are sized
+// from their distance
+void reloadViewportUniform() {
+  renderer.useProgram(geometryProgramID);
+  glUniform2f(geom_viewport, FB_WIDTH, FB_HEIGHT);
 
-  glUseProgram(basicProgramID);
-  glUniform3f(id, // ID in basic_vs.glsl
-              r, g, b);
+  renderer.useProgram(spriteProgramID);
+  glUniform1f(sprite_pixelsPerUnit,
+              FB_HEIGHT / (2 * std::tan(WIN_FOV * M_PI / 360)));
 }
 
 void generateIDs() {
@@ -512,26 +726,86 @@ void generateIDs() {
   std::string vsSource = loadShaderStringfromFile("./shaders/basic_vs.glsl");
   std::string fsSource = loadShaderStringfromFile("./shaders/basic_fs.glsl");
   basicProgramID = CreateShaderProgram(vsSource, fsSource);
+  std::string instancedSource =
+      loadShaderStringfromFile("./shaders/instanced_vs.glsl");
+  instancedProgramID = CreateShaderProgram(instancedSource, fsSource);
+  std::string pointSource =
+      loadShaderStringfromFile("./shaders/boid_point_vs.glsl");
+  std::string gsSource = loadShaderStringfromFile("./shaders/boid_gs.glsl");
+  geometryProgramID = CreateShaderProgram(pointSource, gsSource, fsSource);
+  std::string spriteVsSource =
+      loadShaderStringfromFile("./shaders/sprite_vs.glsl");
+  std::string spriteFsSource =
+      loadShaderStringfromFile("./shaders/sprite_fs.glsl");
+  spriteProgramID = CreateShaderProgram(spriteVsSource, spriteFsSource);
+
+  renderer.create();
+  renderer.attach(basicProgramID);
+  renderer.attach(instancedProgramID);
+  renderer.attach(geometryProgramID);
+  renderer.attach(spriteProgramID);
+  renderer.setColors(Vec3f(1, 0, 1), Vec3f(0, 1, 1)); // glyphs, headings
+
+  basic_drawHeading = glGetUniformLocation(basicProgramID, "drawHeading");
+  inst_drawHeading = glGetUniformLocation(instancedProgramID, "drawHeading");
+  geom_viewport = glGetUniformLocation(geometryProgramID, "viewport");
+  sprite_pixelsPerUnit =
+      glGetUniformLocation(spriteProgramID, "pixelsPerUnit");
+
+  // uniforms that never change are set once
+  renderer.useProgram(instancedProgramID);
+  glUniform1f(glGetUniformLocation(instancedProgramID, "headingLength"), 5);
+  renderer.useProgram(geometryProgramID);
+  glUniform1f(glGetUniformLocation(geometryProgramID, "headingLength"), 5);
+  reloadViewportUniform();
 
   // VAO and buffer IDs given from OpenGL
   glGenVertexArrays(1, &vaoID);
-  glGenBuffers(1, &vertBufferID);
+  quadStream.create();
   glGenVertexArrays(1, &line_vaoID);
-  glGenBuffers(1, &line_vertBufferID);
+  lineStream.create();
+  glGenVertexArrays(1, &wall_vaoID);
+  glGenBuffers(1, &wall_vertBufferID);
+  glGenVertexArrays(1, &inst_vaoID);
+  glGenBuffers(1, &meshBufferID);
+  instanceStream.create();
+  glGenBuffers(1, &flockBufferID);
+  glGenVertexArrays(1, &point_vaoID);
+  glGenVertexArrays(1, &sprite_vaoID);
+  spriteStream.create();
 }
 
 void deleteIDs() {
   glDeleteProgram(basicProgramID);
+  glDeleteProgram(instancedProgramID);
+  glDeleteProgram(geometryProgramID);
+  renderer.destroy();
 
   glDeleteVertexArrays(1, &vaoID);
-  glDeleteBuffers(1, &vertBufferID);
+  quadStream.destroy();
   glDeleteVertexArrays(1, &line_vaoID);
-  glDeleteBuffers(1, &line_vertBufferID);
+  lineStream.destroy();
+  glDeleteVertexArrays(1, &wall_vaoID);
+  glDeleteBuffers(1, &wall_vertBufferID);
+  glDeleteVertexArrays(1, &inst_vaoID);
+  glDeleteBuffers(1, &meshBufferID);
+  instanceStream.destroy();
+  glDeleteBuffers(1, &flockBufferID);
+  glDeleteVertexArrays(1, &point_vaoID);
+  glDeleteProgram(spriteProgramID);
+  glDeleteVertexArrays(1, &sprite_vaoID);
+  spriteStream.destroy();
 }
 
 void init() {
   glEnable(GL_DEPTH_TEST);
   glPointSize(50);
+  glEnable(GL_PROGRAM_POINT_SIZE); // sprites size themselves
+
+  char const *lod = std::getenv("BOIDS_LOD");
+  if (lod && std::sscanf(lod, "%f,%f", &g_lodNear, &g_lodFar) != 2)
+    cerr << "BOIDS_LOD should be near,far, using " << g_lodNear << ","
+         << g_lodFar << endl;
 
   camera = Camera(Vec3f{0, 0, 500}, Vec3f{0, 0, -1}, Vec3f{0, 1, 0});
 
@@ -552,23 +826,25 @@ void init() {
   //cout << d << endl;
   numBoids = input[0];
   numPrey = input[1];
-  fov = input[2];
-  border = input[3];
-  fol = input[4];
+  sim.params().fov = input[2];
+  sim.params().border = input[3];
+  sim.params().fol = input[4];
 
-  setupBoids(numBoids, numPrey);
+  sim.setup(numBoids, numPrey);
+  cout << "flocking kernel: " << flockKernelName(flockKernelVariant()) << endl;
+  cout << "simulation threads: " << sim.pool().size() << endl;
 
   // SETUP SHADERS, BUFFERS, VAOs
 
   generateIDs();
   setupVAO();
-  loadQuadGeometryToGPU();
-  loadLineGeometryToGPU();
+  loadWallGeometryToGPU();
+  loadMeshToGPU();
+  loadBoidsToGPU();
 
   loadModelViewMatrix();
   reloadProjectionMatrix();
   setupModelViewProjectionTransform();
-  reloadMVPUniform();
 }
 
 int main(int argc, char **argv) {
@@ -580,7 +856,7 @@ int main(int argc, char **argv) {
 
   glfwWindowHint(GLFW_SAMPLES, 4);
   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
   glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
   glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
@@ -612,6 +888,7 @@ int main(int argc, char **argv) {
   std::cout << GL_ERROR() << std::endl;
 
   init(); // our own initialize stuff func
+  updateWindowTitle(window);
 
   float t = 0;
   float dt = 0.01;
@@ -624,15 +901,19 @@ int main(int argc, char **argv) {
     if (g_play) {
       glfwGetCursorPos(window, &xpos, &ypos);
       t += dt;
-      place.x() = xpos - WIN_WIDTH/2;
-      place.y() = WIN_HEIGHT/2 - ypos;
-      //printf("x = %f, y = %f\n", place.x(), place.y());
-      animateQuad(t);
-      loadQuadGeometryToGPU();
-      loadLineGeometryToGPU();
+      sim.setTarget(Vec3f(xpos - WIN_WIDTH/2, WIN_HEIGHT/2 - ypos, 0));
+      sim.step();
+      g_reloadBoids = true;
+    }
+
+    if (g_reloadBoids) {
+      loadBoidsToGPU();
+      updateWindowTitle(window);
+      g_reloadBoids = false;
     }
 
     displayFunc();
+    fenceStreams();
     moveCamera();
 
     glfwSwapBuffers(window);
@@ -654,12 +935,12 @@ void windowSetSizeFunc(GLFWwindow *window, int width, int height) {
 
   reloadProjectionMatrix();
   setupModelViewProjectionTransform();
-  reloadMVPUniform();
 }
 
 void windowSetFramebufferSizeFunc(GLFWwindow *window, int width, int height) {
   FB_WIDTH = width;
   FB_HEIGHT = height;
+  reloadViewportUniform();
 
   glViewport(0, 0, FB_WIDTH, FB_HEIGHT);
 }
@@ -683,7 +964,6 @@ void windowMouseMotionFunc(GLFWwindow *window, double x, double y) {
 
     reloadViewMatrix();
     setupModelViewProjectionTransform();
-    reloadMVPUniform();
   }
 
   g_cursorX = x;
@@ -737,7 +1017,51 @@ void windowKeyFunc(GLFWwindow *window, int key, int scancode, int action,
     g_play = set ? !g_play : g_play;
     break;
   case GLFW_KEY_F:
-    followMouse = set ? !followMouse : followMouse;
+    if (set)
+      sim.setFollowTarget(!sim.followsTarget());
+    break;
+  case GLFW_KEY_P:
+    if (set)
+      sim.scalingReport(cout);
+    break;
+  case GLFW_KEY_I:
+    if (set) {
+      g_renderMode = RenderMode((g_renderMode + 1) % RENDER_MODES);
+      loadBoidsToGPU();
+      updateWindowTitle(window);
+      cout << "rendering: " << renderModeName(g_renderMode) << endl;
+    }
+    break;
+  case GLFW_KEY_C:
+    if (set) {
+      g_cull = !g_cull;
+      g_reloadBoids = true;
+      cout << "frustum culling: " << (g_cull ? "on" : "off") << endl;
+    }
+    break;
+  case GLFW_KEY_L:
+    if (set) {
+      g_lod = !g_lod;
+      g_reloadBoids = true;
+      cout << "level of detail: " << (g_lod ? "on" : "off") << endl;
+    }
+    break;
+  case GLFW_KEY_G:
+    if (set) {
+      Simulation::NeighbourSearch search = Simulation::NeighbourSearch(
+          (sim.neighbourSearch() + 1) % Simulation::SEARCH_METHODS);
+      sim.setNeighbourSearch(search);
+      cout << "neighbour search: " << Simulation::neighbourSearchName(search)
+           << endl;
+    }
+    break;
+  case GLFW_KEY_V:
+    if (set) {
+      sim.setVerletSkin(sim.verletSkin() > 0 ? 0
+                                             : Simulation::DEFAULT_VERLET_SKIN);
+      cout << "verlet lists: " << (sim.verletSkin() > 0 ? "on" : "off")
+           << endl;
+    }
     break;
   case GLFW_KEY_LEFT_BRACKET:
     if (mods == GLFW_MOD_SHIFT) {
@@ -788,7 +1112,6 @@ void moveCamera() {
     camera.move(dir);
     reloadViewMatrix();
     setupModelViewProjectionTransform();
-    reloadMVPUniform();
   }
 }
 
@@ -0,0 +1,402 @@
+/**
+ * File:	bench.cpp
+ *
+ * Summary:
+ *
+ * boids_bench, times Simulation::step over a range of flock sizes and
+ * starting layouts, and prints the results as JSON on stdout so runs from
+ * different builds can be diffed. Progress goes to stderr.
+ *
+ * Every configuration is a scenario (where the boids start), a flock size,
+ * a neighbour search method and a kernel. A configuration whose first
+ * step would test more than --max-pairs candidate pairs is reported as
+ * skipped instead of run, so the all-pairs search and the one cell
+ * scenario don't take hours at large sizes. Where the hardware cache
+ * counters can be read, the timed steps' misses are reported too. The
+ * grid build every step ends with is timed on its own as well, and for
+ * the grid searches how many boids the steps' grid updates moved.
+ *
+ * usage: boids_bench [--n 1000,10000,...] [--scenarios uniform,...]
+ *                    [--methods grid,...] [--kernels best|all]
+ *                    [--steps n] [--budget seconds] [--max-pairs n]
+ *                    [--seed n] [--threads n] [--morton n]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "FlockKernel.h"
+#include "PerfCounters.h"
+#include "Simulation.h"
+#include "SpatialGrid.h"
+
+using namespace std;
+
+namespace {
+
+// separate grid builds timed per configuration, the median reported
+int const GRID_BUILDS = 5;
+
+// Where the boids start. Velocities are whatever setup() gave them.
+struct Scenario {
+  char const *name;
+  unsigned predatorPercent;
+  void (*place)(Simulation &sim);
+};
+
+// uniform in a cube grown with n to keep the density of 10k boids in the
+// border cube, so large flocks get more cells rather than more neighbours
+void placeUniform(Simulation &sim) {
+  BoidSystem &boids = sim.boids();
+  float side = 2 * sim.params().border * std::cbrt(boids.size() / 10000.f);
+  for (unsigned i = 0; i < boids.size(); i++) {
+    Vec3f p(rand() / float(RAND_MAX), rand() / float(RAND_MAX),
+            rand() / float(RAND_MAX));
+    boids.setPosition(i, (p - Vec3f(0.5, 0.5, 0.5)) * side);
+  }
+}
+
+// as setup() leaves them, the 100 wide cube the window starts with
+void placeCluster(Simulation &) {}
+
+// inside a cube half the follow radius wide, a single grid cell
+void placeOneCell(Simulation &sim) {
+  BoidSystem &boids = sim.boids();
+  float side = sim.params().fol / 2.f;
+  for (unsigned i = 0; i < boids.size(); i++) {
+    Vec3f p(rand() / float(RAND_MAX), rand() / float(RAND_MAX),
+            rand() / float(RAND_MAX));
+    boids.setPosition(i, p * side);
+  }
+}
+
+// a few dense balls, one follow radius wide each, somewhere inside the
+// border, the way long runs end up. Most grid cells are empty and the rest
+// hold a whole ball's worth of candidates, half of them out of reach.
+void placeBalls(Simulation &sim) {
+  BoidSystem &boids = sim.boids();
+  int const balls = 4;
+  float radius = sim.params().fol;
+  float spread = std::max(0.f, sim.params().border - radius);
+
+  Vec3f centres[balls];
+  for (Vec3f &c : centres)
+    c = Vec3f(rand() / float(RAND_MAX), rand() / float(RAND_MAX),
+              rand() / float(RAND_MAX)) * (2 * spread) -
+        Vec3f(spread, spread, spread);
+
+  for (unsigned i = 0; i < boids.size(); i++) {
+    // uniform in the ball, by rejection from its cube
+    Vec3f p;
+    do {
+      p = Vec3f(rand() / float(RAND_MAX), rand() / float(RAND_MAX),
+                rand() / float(RAND_MAX)) * 2 - Vec3f(1, 1, 1);
+    } while (p.lengthSquared() > 1);
+    boids.setPosition(i, centres[i % balls] + p * radius);
+  }
+}
+
+Scenario const scenarios[] = {
+    {"uniform", 0, placeUniform},
+    {"cluster", 0, placeCluster},
+    {"predators", 10, placeUniform},
+    {"onecell", 0, placeOneCell},
+    {"balls", 0, placeBalls},
+};
+
+// Neighbour search methods, the ones a faster variant would be added to
+struct Method {
+  char const *name;
+  void (*configure)(Simulation &sim);
+};
+
+Method const methods[] = {
+    {"grid",
+     [](Simulation &sim) {
+       sim.setNeighbourSearch(Simulation::SEARCH_GRID);
+       sim.setVerletSkin(0);
+     }},
+    {"octree",
+     [](Simulation &sim) {
+       sim.setNeighbourSearch(Simulation::SEARCH_OCTREE);
+       sim.setVerletSkin(0);
+     }},
+    {"brute",
+     [](Simulation &sim) {
+       sim.setNeighbourSearch(Simulation::SEARCH_BRUTE);
+       sim.setVerletSkin(0);
+     }},
+    {"verlet",
+     [](Simulation &sim) {
+       sim.setNeighbourSearch(Simulation::SEARCH_GRID);
+       sim.setVerletSkin(Simulation::DEFAULT_VERLET_SKIN);
+     }},
+};
+
+struct Options {
+  vector<unsigned> sizes;
+  vector<string> scenarios;
+  vector<string> methods;
+  bool allKernels;
+  unsigned steps;
+  double budget;
+  double maxPairs;
+  unsigned seed;
+  unsigned threads;
+  unsigned morton;
+};
+
+vector<string> split(char const *list) {
+  vector<string> items;
+  stringstream in(list);
+  string item;
+  while (getline(in, item, ','))
+    if (!item.empty())
+      items.push_back(item);
+  return items;
+}
+
+bool wanted(vector<string> const &list, char const *name) {
+  return find(list.begin(), list.end(), name) != list.end();
+}
+
+// nearest rank, sorted must be sorted and not empty
+double percentile(vector<double> const &sorted, double p) {
+  unsigned rank = unsigned(std::ceil(p * sorted.size()));
+  return sorted[std::max(1u, rank) - 1];
+}
+
+void usage() {
+  cerr << "usage: boids_bench [--n 1000,10000,...] [--scenarios uniform,...]\n"
+          "                   [--methods grid,...] [--kernels best|all]\n"
+          "                   [--steps n] [--budget seconds] [--max-pairs n]\n"
+          "                   [--seed n] [--threads n] [--morton n]\n"
+          "\n"
+          "  --n          flock sizes, default 1000,10000,100000,1000000\n"
+          "  --scenarios  uniform, cluster, predators, onecell, balls,\n"
+          "               default all\n"
+          "  --methods    grid, octree, brute, verlet (lists over the grid),\n"
+          "               default all\n"
+          "  --kernels    best, or all the cpu supports, default best\n"
+          "  --steps      timed steps per configuration, default 10\n"
+          "  --budget     stop timing a configuration after this many\n"
+          "               seconds, once 3 steps are in, default 20\n"
+          "  --max-pairs  skip configurations testing more candidate pairs\n"
+          "               per step, default 1e9\n"
+          "  --seed       srand() seed, default 1\n"
+          "  --threads    simulation threads, default BOIDS_THREADS or "
+          "every core\n"
+          "  --morton     steps between Morton order re-sorts, 0 for none,\n"
+          "               default 64"
+       << endl;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options opt;
+  opt.sizes = {1000, 10000, 100000, 1000000};
+  for (Scenario const &s : scenarios)
+    opt.scenarios.push_back(s.name);
+  for (Method const &m : methods)
+    opt.methods.push_back(m.name);
+  opt.allKernels = false;
+  opt.steps = 10;
+  opt.budget = 20;
+  opt.maxPairs = 1e9;
+  opt.morton = Simulation::DEFAULT_MORTON_INTERVAL;
+  opt.seed = 1;
+  opt.threads = ThreadPool::defaultThreads();
+
+  for (int i = 1; i < argc; i++) {
+    char const *arg = argv[i];
+    if (!strcmp(arg, "--help") || !strcmp(arg, "-h")) {
+      usage();
+      return 0;
+    }
+    if (i + 1 >= argc) {
+      cerr << "missing value for " << arg << endl;
+      usage();
+      return 1;
+    }
+    char const *value = argv[++i];
+
+    if (!strcmp(arg, "--n")) {
+      opt.sizes.clear();
+      for (string const &n : split(value))
+        opt.sizes.push_back(atoi(n.c_str()));
+    } else if (!strcmp(arg, "--scenarios")) {
+      opt.scenarios = split(value);
+    } else if (!strcmp(arg, "--methods")) {
+      opt.methods = split(value);
+    } else if (!strcmp(arg, "--kernels")) {
+      opt.allKernels = !strcmp(value, "all");
+    } else if (!strcmp(arg, "--steps")) {
+      opt.steps = std::max(1, atoi(value));
+    } else if (!strcmp(arg, "--budget")) {
+      opt.budget = atof(value);
+    } else if (!strcmp(arg, "--max-pairs")) {
+      opt.maxPairs = atof(value);
+    } else if (!strcmp(arg, "--seed")) {
+      opt.seed = atoi(value);
+    } else if (!strcmp(arg, "--threads") && atoi(value) > 0) {
+      opt.threads = atoi(value);
+    } else if (!strcmp(arg, "--morton") && atoi(value) >= 0) {
+      opt.morton = atoi(value);
+    } else {
+      cerr << "bad argument " << arg << " " << value << endl;
+      usage();
+      return 1;
+    }
+  }
+
+  vector<FlockKernelVariant> kernels;
+  if (opt.allKernels) {
+    FlockKernelVariant all[] = {KERNEL_SCALAR, KERNEL_SSE42, KERNEL_AVX2};
+    for (FlockKernelVariant v : all)
+      if (flockKernelSupported(v))
+        kernels.push_back(v);
+  } else {
+    kernels.push_back(flockKernelVariant());
+  }
+
+  // cache misses of the main thread, the whole step with --threads 1
+  PerfCounters counters;
+  if (!counters.available())
+    cerr << "cache counters unavailable, " << counters.error() << endl;
+
+  Simulation sim(opt.threads);
+  sim.setMortonInterval(opt.morton);
+  SpatialGrid grid;
+  cout.precision(8);
+
+  cout << "{" << endl;
+  cout << "  \"threads\": " << sim.pool().size() << "," << endl;
+  cout << "  \"seed\": " << opt.seed << "," << endl;
+  cout << "  \"morton_interval\": " << opt.morton << "," << endl;
+  cout << "  \"results\": [";
+
+  char const *separator = "\n";
+  for (Scenario const &scenario : scenarios) {
+    if (!wanted(opt.scenarios, scenario.name))
+      continue;
+    for (unsigned n : opt.sizes) {
+      for (Method const &method : methods) {
+        if (!wanted(opt.methods, method.name))
+          continue;
+        for (FlockKernelVariant kernel : kernels) {
+          setFlockKernelVariant(kernel);
+
+          unsigned numPreds = std::max(2u, n * scenario.predatorPercent / 100);
+          numPreds = std::min(numPreds, n);
+          srand(opt.seed);
+          sim.setup(n - numPreds, numPreds);
+          scenario.place(sim);
+          sim.boidsMoved();
+          method.configure(sim);
+
+          cerr << scenario.name << " n=" << n << " " << method.name << " "
+               << flockKernelName(kernel) << ": ";
+
+          cout << separator << "    {\"scenario\": \"" << scenario.name
+               << "\", \"n\": " << n << ", \"predators\": " << numPreds
+               << ", \"method\": \"" << method.name << "\", \"kernel\": \""
+               << flockKernelName(kernel) << "\", ";
+          separator = ",\n";
+
+          double pairs = sim.candidatePairs();
+          if (pairs > opt.maxPairs) {
+            cerr << "skipped, " << pairs << " pairs per step" << endl;
+            cout << "\"skipped\": true, \"pairs_per_step\": " << pairs << "}";
+            continue;
+          }
+
+          sim.step(); // warm up, first touch of the back buffer and grid
+
+          vector<double> times;
+          double totalPairs = 0;
+          double spent = 0;
+          double misses[PerfCounters::EVENTS] = {};
+          double migrated = 0;
+          unsigned gridUpdates = 0, gridBuilds = 0;
+          while (times.size() < opt.steps &&
+                 (times.size() < 3 || spent < opt.budget)) {
+            totalPairs += sim.candidatePairs();
+
+            counters.start();
+            auto start = chrono::steady_clock::now();
+            sim.step();
+            chrono::duration<double> elapsed =
+                chrono::steady_clock::now() - start;
+            counters.stop();
+            for (int e = 0; e < PerfCounters::EVENTS; e++)
+              misses[e] += counters.count(PerfCounters::Event(e));
+
+            times.push_back(elapsed.count());
+            spent += elapsed.count();
+
+            if (SpatialGrid const *stepGrid = sim.grid()) {
+              if (stepGrid->rebuilt()) {
+                gridBuilds++;
+              } else {
+                migrated += stepGrid->migrated();
+                gridUpdates++;
+              }
+            }
+          }
+
+          // the grid over the final flock, built on its own a few times
+          BoidSystem const &boids = sim.boids();
+          vector<double> builds;
+          for (int b = 0; b < GRID_BUILDS; b++) {
+            auto start = chrono::steady_clock::now();
+            grid.build(boids.x(), boids.y(), boids.z(), boids.size(),
+                       sim.params().fol, sim.pool());
+            chrono::duration<double> elapsed =
+                chrono::steady_clock::now() - start;
+            builds.push_back(elapsed.count());
+          }
+          sort(builds.begin(), builds.end());
+          double gridBuild = percentile(builds, 0.5);
+
+          sort(times.begin(), times.end());
+          double median = percentile(times, 0.5);
+          double p95 = percentile(times, 0.95);
+          double pairsPerStep = totalPairs / times.size();
+
+          cerr << median * 1e3 << " ms/step, grid build " << gridBuild * 1e3
+               << " ms" << endl;
+          cout << "\"skipped\": false, \"steps\": " << times.size()
+               << ", \"median_ms\": " << median * 1e3
+               << ", \"p95_ms\": " << p95 * 1e3
+               << ", \"boids_per_sec\": " << n / median
+               << ", \"pairs_per_step\": " << pairsPerStep
+               << ", \"pairs_per_sec\": " << pairsPerStep / median
+               << ", \"grid_build_ms\": " << gridBuild * 1e3;
+          if (gridUpdates + gridBuilds > 0)
+            cout << ", \"grid_rebuilds\": " << gridBuilds
+                 << ", \"grid_migrated_per_update\": "
+                 << (gridUpdates > 0 ? migrated / gridUpdates : 0);
+          if (counters.has(PerfCounters::CACHE_MISSES))
+            cout << ", \"cache_misses_per_step\": "
+                 << misses[PerfCounters::CACHE_MISSES] / times.size();
+          if (counters.has(PerfCounters::L1D_READ_MISSES))
+            cout << ", \"l1d_read_misses_per_step\": "
+                 << misses[PerfCounters::L1D_READ_MISSES] / times.size();
+          cout << "}";
+        }
+      }
+    }
+  }
+
+  cout << "\n  ]" << endl;
+  cout << "}" << endl;
+  return 0;
+}
@@ -0,0 +1,253 @@
+/**
+ * File:	headless.cpp
+ *
+ * Summary:
+ *
+ * boids_headless, runs the simulation without a window as fast as it will
+ * go and reports the step rate, and the cache misses of the steps where
+ * the hardware counters can be read. Links only the simulation code, so
+ * it builds and runs on machines without GLFW or a GPU.
+ *
+ * usage: boids_headless [--boids n] [--preds n] [--steps n] [--seed n]
+ *                       [--fov deg] [--border n] [--fol n] [--threads n]
+ *                       [--brute | --octree] [--verlet skin] [--morton n]
+ *                       [--full-grid] [--check-grid] [--scaling]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "FlockKernel.h"
+#include "PerfCounters.h"
+#include "Simulation.h"
+
+using namespace std;
+
+static void usage() {
+  cerr << "usage: boids_headless [--boids n] [--preds n] [--steps n] "
+          "[--seed n]\n"
+          "                      [--fov deg] [--border n] [--fol n] "
+          "[--threads n]\n"
+          "                      [--brute | --octree] [--verlet skin] "
+          "[--morton n]\n"
+          "                      [--full-grid] [--check-grid] [--scaling]\n"
+          "\n"
+          "  --boids    prey boids, default 500\n"
+          "  --preds    predator boids, default 2\n"
+          "  --steps    steps to run, default 1000\n"
+          "  --seed     srand() seed for the starting flock, default 1\n"
+          "  --fov      field of view in degrees, default 270\n"
+          "  --border   size of border, default 300\n"
+          "  --fol      radius for following, default 80\n"
+          "  --threads  simulation threads, default BOIDS_THREADS or every "
+          "core\n"
+          "  --brute    all-pairs neighbour search instead of the grid\n"
+          "  --octree   octree neighbour search instead of the grid\n"
+          "  --verlet   prey reuse neighbour lists this much wider than the "
+          "follow\n"
+          "             radius until one moves half as far, 10 is usual\n"
+          "  --morton   steps between Morton order re-sorts, 0 for none, "
+          "default 64\n"
+          "  --full-grid  build the grid anew every step instead of moving "
+          "the boids\n"
+          "             that changed cell\n"
+          "  --check-grid  after every step check each boid lies inside the "
+          "box of\n"
+          "             its grid cell, exits 1 if one doesn't\n"
+          "  --scaling  also time 1, 2, 4 ... threads on the final flock"
+       << endl;
+}
+
+int main(int argc, char **argv) {
+  unsigned numBoids = 500;
+  unsigned numPreds = 2;
+  unsigned steps = 1000;
+  unsigned seed = 1;
+  unsigned threads = ThreadPool::defaultThreads();
+  Simulation::NeighbourSearch search = Simulation::SEARCH_GRID;
+  bool scaling = false;
+  bool incrementalGrid = true;
+  bool checkGrid = false;
+  float skin = 0;
+  unsigned morton = Simulation::DEFAULT_MORTON_INTERVAL;
+  SimulationParams params;
+
+  for (int i = 1; i < argc; i++) {
+    char const *arg = argv[i];
+    char const *value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+    if (!strcmp(arg, "--brute")) {
+      search = Simulation::SEARCH_BRUTE;
+      continue;
+    }
+    if (!strcmp(arg, "--octree")) {
+      search = Simulation::SEARCH_OCTREE;
+      continue;
+    }
+    if (!strcmp(arg, "--full-grid")) {
+      incrementalGrid = false;
+      continue;
+    }
+    if (!strcmp(arg, "--check-grid")) {
+      checkGrid = true;
+      continue;
+    }
+    if (!strcmp(arg, "--scaling")) {
+      scaling = true;
+      continue;
+    }
+    if (!strcmp(arg, "--help") || !strcmp(arg, "-h")) {
+      usage();
+      return 0;
+    }
+    if (!value) {
+      cerr << "missing value for " << arg << endl;
+      usage();
+      return 1;
+    }
+
+    int n = atoi(value);
+    i++;
+    if (!strcmp(arg, "--boids"))
+      numBoids = n;
+    else if (!strcmp(arg, "--preds"))
+      numPreds = n;
+    else if (!strcmp(arg, "--steps"))
+      steps = n;
+    else if (!strcmp(arg, "--seed"))
+      seed = n;
+    else if (!strcmp(arg, "--fov"))
+      params.fov = n;
+    else if (!strcmp(arg, "--border"))
+      params.border = n;
+    else if (!strcmp(arg, "--fol"))
+      params.fol = n;
+    else if (!strcmp(arg, "--threads") && n > 0)
+      threads = n;
+    else if (!strcmp(arg, "--verlet"))
+      skin = n;
+    else if (!strcmp(arg, "--morton") && n >= 0)
+      morton = n;
+    else {
+      cerr << "bad argument " << arg << " " << value << endl;
+      usage();
+      return 1;
+    }
+  }
+
+  Simulation sim(threads);
+  sim.params() = params;
+  sim.setNeighbourSearch(search);
+  sim.setVerletSkin(skin);
+  sim.setMortonInterval(morton);
+  sim.setIncrementalGrid(incrementalGrid);
+  srand(seed);
+  sim.setup(numBoids, numPreds);
+
+  unsigned n = sim.boids().size();
+  cout << "boids " << n << " (" << numPreds << " predators), steps " << steps
+       << ", seed " << seed << endl;
+  cout << "kernel " << flockKernelName(flockKernelVariant()) << ", threads "
+       << sim.pool().size() << ", " << Simulation::neighbourSearchName(search);
+  if (skin > 0)
+    cout << ", verlet lists skin " << skin;
+  if (morton > 0)
+    cout << ", morton order every " << morton << " steps";
+  if (search == Simulation::SEARCH_GRID && !incrementalGrid)
+    cout << ", full grid builds";
+  cout << endl;
+
+  PerfCounters counters;
+  counters.start();
+  // furthest any boid was outside the box the grid gives its cell, what
+  // the viewer culls by
+  float worstOutside = 0;
+  auto all = [](Vec3f const &, Vec3f const &) { return 1; };
+  auto checkCell = [&](Vec3f const &lo, Vec3f const &hi,
+                       unsigned const *indices, unsigned count) {
+    for (unsigned k = 0; k < count; k++) {
+      Vec3f p = sim.boids().position(indices[k]);
+      for (int a = 0; a < 3; a++)
+        worstOutside =
+            std::max(worstOutside, std::max(lo[a] - p[a], p[a] - hi[a]));
+    }
+  };
+
+  // boids that changed cell in the steps that updated the grid
+  unsigned long long migrated = 0, gridUpdates = 0, gridBuilds = 0;
+  auto start = chrono::steady_clock::now();
+  for (unsigned s = 0; s < steps; s++) {
+    sim.step();
+    if (SpatialGrid const *grid = sim.grid()) {
+      if (checkGrid)
+        grid->forEachCellIn(all, 0, checkCell);
+      if (grid->rebuilt()) {
+        gridBuilds++;
+      } else {
+        migrated += grid->migrated();
+        gridUpdates++;
+      }
+    }
+  }
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+  counters.stop();
+
+  double seconds = elapsed.count();
+  cout << "time " << seconds << " s" << endl;
+  if (steps > 0 && n > 0) {
+    cout << "steps/sec " << steps / seconds << endl;
+    cout << "ns/boid/step " << seconds * 1e9 / (double(steps) * n) << endl;
+  }
+  if (morton > 0)
+    cout << "morton sorts " << sim.mortonSorts() << endl;
+  if (search == Simulation::SEARCH_GRID) {
+    cout << "grid built " << gridBuilds << " times, updated " << gridUpdates
+         << " times";
+    if (gridUpdates > 0 && n > 0)
+      cout << ", boids changing cell/update " << migrated / double(gridUpdates)
+           << " (" << 100 * migrated / (double(gridUpdates) * n) << "%)";
+    cout << endl;
+  }
+  if (skin > 0)
+    cout << "verlet lists built " << sim.neighbourLists().builds()
+         << " times, " << sim.neighbourLists().entries() << " entries"
+         << endl;
+
+  // rounding can put a boid on the wrong side of a cell's face by a hair
+  bool gridOk = worstOutside <= 1e-3f;
+  if (checkGrid)
+    cout << "grid cell boxes " << (gridOk ? "hold" : "miss")
+         << " their boids, worst outside by " << worstOutside << endl;
+
+  // per step, of the calling thread only, see PerfCounters
+  if (!counters.available()) {
+    cout << "cache counters unavailable, " << counters.error() << endl;
+  } else if (steps > 0) {
+    if (sim.pool().size() > 1)
+      cout << "cache counters see the main thread only, use --threads 1"
+           << endl;
+    for (int e = 0; e < PerfCounters::EVENTS; e++) {
+      PerfCounters::Event event = PerfCounters::Event(e);
+      if (counters.has(event))
+        cout << PerfCounters::eventName(event) << "/step "
+             << counters.count(event) / double(steps) << endl;
+    }
+    double references = counters.count(PerfCounters::CACHE_REFERENCES);
+    if (counters.has(PerfCounters::CACHE_MISSES) && references > 0)
+      cout << "cache miss rate "
+           << 100 * counters.count(PerfCounters::CACHE_MISSES) / references
+           << "%" << endl;
+  }
+
+  // where the flock ended up, to compare runs with the same seed
+  Vec3f c = computeFlockStats(sim.boids(), sim.pool()).centroid;
+  cout << "centroid " << c.x() << " " << c.y() << " " << c.z() << endl;
+
+  if (scaling)
+    sim.scalingReport(cout);
+
+  return checkGrid && !gridOk ? 1 : 0;
+}
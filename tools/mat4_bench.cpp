@@ -0,0 +1,90 @@
+/**
+ * File:	mat4_bench.cpp
+ *
+ * Summary:
+ *
+ * boids_mat4_bench, times the matrix work the window does for a frame in
+ * which the camera moves: orbit the camera, rebuild the view with
+ * LookAtMatrix, build MVP = P * V * M, plus a quaternion to matrix. Counts
+ * heap allocations by replacing the global operator new, and reports
+ * allocations and nanoseconds per frame, and per 4x4 multiply.
+ *
+ * usage: boids_mat4_bench [--frames n]
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+#include "Camera.h"
+#include "Mat4f.h"
+#include "OpenGLMatrixTools.h"
+#include "Quat4f.h"
+
+using namespace std;
+
+static unsigned long long allocations = 0;
+
+void *operator new(size_t size) {
+  allocations++;
+  if (void *p = malloc(size ? size : 1))
+    return p;
+  throw bad_alloc();
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+// keeps the optimizer from dropping the work
+static float sink = 0;
+
+int main(int argc, char **argv) {
+  unsigned frames = 1000000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--frames") && i + 1 < argc) {
+      frames = max(1, atoi(argv[++i]));
+    } else {
+      cerr << "usage: boids_mat4_bench [--frames n]" << endl;
+      return strcmp(argv[i], "--help") ? 1 : 0;
+    }
+  }
+
+  Camera camera(Vec3f{0, 0, 500}, Vec3f{0, 0, -1}, Vec3f{0, 1, 0});
+  Mat4f P = PerspectiveProjection(60, 800.f / 600.f, 0.01, 1000);
+  Mat4f M = IdentityMatrix();
+  Quat4f spin(std::cos(0.01f), Vec3f(0, std::sin(0.01f), 0));
+
+  unsigned long long before = allocations;
+  auto start = chrono::steady_clock::now();
+  for (unsigned f = 0; f < frames; f++) {
+    camera.rotateAroundFocus(0.001f, 0.0005f);
+    Mat4f V = camera.lookatMatrix();
+    Mat4f MVP = P * V * (M * spin.matrix4f());
+    sink += MVP[f & 15];
+  }
+  chrono::duration<double, nano> frameTime = chrono::steady_clock::now() - start;
+  unsigned long long frameAllocations = allocations - before;
+
+  // the multiply on its own, a chain so each depends on the last
+  Mat4f A = P * camera.lookatMatrix();
+  Mat4f B = spin.matrix4f();
+  before = allocations;
+  start = chrono::steady_clock::now();
+  for (unsigned f = 0; f < frames; f++)
+    A = A * B;
+  chrono::duration<double, nano> multiplyTime =
+      chrono::steady_clock::now() - start;
+  unsigned long long multiplyAllocations = allocations - before;
+  sink += A[0];
+
+  cout << "frames " << frames << endl;
+  cout << "allocations/frame " << double(frameAllocations) / frames << endl;
+  cout << "ns/frame " << frameTime.count() / frames << endl;
+  cout << "allocations/multiply " << double(multiplyAllocations) / frames
+       << endl;
+  cout << "ns/multiply " << multiplyTime.count() / frames << endl;
+  cerr << "(" << sink << ")" << endl;
+  return 0;
+}